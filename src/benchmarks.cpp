@@ -0,0 +1,1266 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <thread>
+
+#include "game.hpp"
+#include "kd_tree.hpp"
+#include "keybinds.hpp"
+#include "collision.hpp"
+#include "maths.hpp"
+#include "replay.hpp"
+#include "rewind.hpp"
+#include "segment_bvh.hpp"
+#include "simd.hpp"
+#include "snapshot.hpp"
+#include "spatial_grid.hpp"
+#include "timer_wheel.hpp"
+#include "to_string.hpp"
+
+
+// Benchmarks for the headless simulation driver, run with "ld40_sim --bench <name>"
+
+constexpr float BENCH_DT{1.0f / 120.0f};
+constexpr double BENCH_MIN_SECONDS{0.5};
+
+
+// Runs func repeatedly for at least BENCH_MIN_SECONDS, returns average ms per run
+template<typename FUNC>
+double TimeAverageMs(FUNC &&func)
+{
+  using clock = std::chrono::steady_clock;
+
+  auto time_start = clock::now();
+  std::chrono::duration<double> elapsed{0.0};
+  int runs = 0;
+
+  while (elapsed.count() < BENCH_MIN_SECONDS)
+  {
+    func();
+    runs++;
+    elapsed = clock::now() - time_start;
+  }
+
+  return elapsed.count() * 1000.0 / runs;
+}
+
+
+// Width and height of a square level holding count things at roughly in-game density
+float ArenaSize(int count)
+{
+  return std::sqrt(float(count)) * 60.0f;
+}
+
+
+// Scatter monsters and projectiles at roughly in-game density, so the
+// arena grows with the number of entities.
+void FillArena(Game &game, int num_projectiles, int num_monsters)
+{
+  GameState &state = game.gamestate;
+  state.world_items.clear();
+  state.world_projectiles.SetCapacity(std::max(num_projectiles, DEFAULT_PROJECTILE_CAPACITY), Overflow_Policy::refuse);
+  state.world_monsters.clear();
+  state.monster_spawns.clear(TimerTick(state.wallclock));
+
+  const float size = ArenaSize(num_monsters);
+  const vec2 min_pos{0.0f, 0.0f};
+  const vec2 max_pos{size, size};
+
+  for (int i = 0; i < num_monsters; i++)
+  {
+    Monster m = game.GenerateRandomMonster(game.random.Position(min_pos, max_pos));
+    m.health = {1000000, 1000000};
+    state.world_monsters.Insert(m);
+  }
+
+  for (int i = 0; i < num_projectiles; i++)
+  {
+    Projectile p;
+    p.position = p.last_position = game.random.Position(min_pos, max_pos);
+    p.velocity = angle_to_vec2(game.random.Float(0.0f, TWO_PI), 800.0f);
+    p.radius = 20.0f;
+    p.damage = 1;
+    p.expire_time = 1000000.0f;
+    state.world_projectiles.Add(p);
+  }
+}
+
+
+// A new game with an arena of num_monsters melee monsters, world_grid over
+// it and the player in the middle.  Returns the arena size.
+float MeleeArena(Game &game, int num_monsters)
+{
+  game.NewGame();
+  FillArena(game, 0, num_monsters);
+
+  GameState &state = game.gamestate;
+  for (auto &monster : state.world_monsters)
+  {
+    monster.type = Monster_Type::melee;
+  }
+
+  const float size = ArenaSize(num_monsters);
+  game.world_grid.Resize({0.0f, 0.0f}, {size, size}, 40.0f);
+  state.player.position = state.player.last_position = {size * 0.5f, size * 0.5f};
+  return size;
+}
+
+
+void bench_broadphase()
+{
+  std::cout << "Projectile vs monster collision pass" << std::endl;
+
+  for (int count : {1000, 10000})
+  {
+    Game game;
+    game.NewGame();
+    FillArena(game, count, count);
+
+    GameState &state = game.gamestate;
+
+    // The original all-pairs loop
+    double nested_ms = TimeAverageMs([&] {
+      ProjectileStore &projectiles = state.world_projectiles;
+      projectiles.Integrate(BENCH_DT);
+
+      for (int p = 0; p < projectiles.size(); p++)
+      {
+        for (auto &monster : state.world_monsters)
+        {
+          if (game.Collides(projectiles.Position(p), projectiles.radius[p], monster.position, monster.radius))
+          {
+            monster.health.current -= projectiles.damage[p];
+          }
+        }
+      }
+    });
+
+    SpatialGrid grid;
+    double grid_ms = TimeAverageMs([&] {
+      grid.Clear();
+      for (auto &monster : state.world_monsters)
+      {
+        grid.Add(monster.position, monster.radius);
+      }
+      grid.Build();
+
+      ProjectileStore &projectiles = state.world_projectiles;
+      projectiles.Integrate(BENCH_DT);
+
+      for (int p = 0; p < projectiles.size(); p++)
+      {
+        grid.QueryOverlaps(projectiles.Position(p), projectiles.radius[p], [&](int index) {
+          state.world_monsters[index].health.current -= projectiles.damage[p];
+        });
+      }
+    });
+
+    double tick_ms = TimeAverageMs([&] { game.Update(BENCH_DT); });
+
+    std::cout << "  " << count << " x " << count << ":"
+              << "  nested " << nested_ms << "ms (" << (1000.0 / nested_ms) << " ticks/s)"
+              << "  grid " << grid_ms << "ms (" << (1000.0 / grid_ms) << " ticks/s)"
+              << "  full Game::Update " << tick_ms << "ms (" << (1000.0 / tick_ms) << " ticks/s)"
+              << std::endl;
+  }
+}
+
+
+void bench_projectiles()
+{
+  constexpr int count = 100000;
+
+  std::cout << "Integrating " << count << " projectiles" << std::endl;
+
+  Game game;
+  FillArena(game, count, 0);
+
+  ProjectileStore &store = game.gamestate.world_projectiles;
+
+  // The old array of structs update, one projectile at a time
+  std::vector<Projectile> array_of_structs;
+  for (int i = 0; i < store.size(); i++)
+  {
+    array_of_structs.push_back(store.Get(i));
+  }
+
+  double aos_ms = TimeAverageMs([&] {
+    for (auto &projectile : array_of_structs)
+    {
+      projectile.last_position = projectile.position;
+      projectile.position += (projectile.velocity * BENCH_DT);
+    }
+  });
+
+  std::cout << "  array of structs:  " << aos_ms << "ms" << std::endl;
+
+  const SimdLevel best = GetSimdLevel();
+  for (SimdLevel level : {SimdLevel::scalar, SimdLevel::sse2, SimdLevel::avx2})
+  {
+    if (level > best) continue;
+    ForceSimdLevel(level);
+
+    double soa_ms = TimeAverageMs([&] { store.Integrate(BENCH_DT); });
+
+    std::cout << "  struct of arrays (" << GetSimdLevelName(level) << "):  " << soa_ms << "ms" << std::endl;
+  }
+  ForceSimdLevel(best);
+}
+
+
+void bench_overlap()
+{
+  constexpr int count = 100000;
+  constexpr int queries = 64;
+
+  std::cout << "Testing " << queries << " circles against " << count << " circles" << std::endl;
+
+  Game game;
+  FillArena(game, 0, count);
+
+  CircleList circles;
+  for (auto &monster : game.gamestate.world_monsters)
+  {
+    circles.Add(monster.position, monster.radius);
+  }
+
+  std::vector<vec2> query_points;
+  for (int q = 0; q < queries; q++)
+  {
+    query_points.push_back(game.gamestate.world_monsters[q].position);
+  }
+
+  int scalar_hits = 0;
+  double collides_ms = TimeAverageMs([&] {
+    scalar_hits = 0;
+    for (vec2 point : query_points)
+    {
+      for (int i = 0; i < circles.size(); i++)
+      {
+        if (game.Collides(point, 20.0f, {circles.x[i], circles.y[i]}, circles.radius[i])) scalar_hits++;
+      }
+    }
+  });
+
+  std::cout << "  Game::Collides loop:  " << collides_ms << "ms  (" << scalar_hits << " hits)" << std::endl;
+
+  std::vector<uint64_t> hits;
+  const SimdLevel best = GetSimdLevel();
+  for (SimdLevel level : {SimdLevel::scalar, SimdLevel::sse2, SimdLevel::avx2})
+  {
+    if (level > best) continue;
+    ForceSimdLevel(level);
+
+    int batch_hits = 0;
+    double batch_ms = TimeAverageMs([&] {
+      batch_hits = 0;
+      for (vec2 point : query_points)
+      {
+        OverlapBatch(point, 20.0f, circles, hits);
+        ForEachHit(hits.data(), circles.size(), [&](int) { batch_hits++; });
+      }
+    });
+
+    std::cout << "  OverlapBatch (" << GetSimdLevelName(level) << "):  " << batch_ms << "ms  ("
+              << batch_hits << " hits)" << std::endl;
+  }
+  ForceSimdLevel(best);
+}
+
+
+void bench_threads()
+{
+  constexpr int num_projectiles = 100000;
+  constexpr int num_monsters = 50000;
+  constexpr int ticks = 60;
+
+  std::cout << "Game::Update with " << num_projectiles << " projectiles and "
+            << num_monsters << " monsters, " << ticks << " ticks" << std::endl;
+
+  Game setup;
+  FillArena(setup, num_projectiles, num_monsters);
+  for (auto &monster : setup.gamestate.world_monsters)
+  {
+    monster.health = {1000, 1000};
+  }
+
+  const int max_threads = std::max(4u, std::thread::hardware_concurrency());
+
+  double single_ms = 0.0;
+  uint64_t single_checksum = 0;
+
+  for (int threads = 1; threads <= max_threads; threads *= 2)
+  {
+    Game game;
+    game.SetThreadCount(threads);
+    game.gamestate = setup.gamestate;
+
+    auto time_start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks; t++)
+    {
+      game.Tick(BENCH_DT);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - time_start;
+
+    double tick_ms = elapsed.count() * 1000.0 / ticks;
+    uint64_t checksum = StateChecksum(game.gamestate);
+
+    if (threads == 1)
+    {
+      single_ms = tick_ms;
+      single_checksum = checksum;
+    }
+
+    std::cout << "  " << threads << " threads:  " << tick_ms << "ms/tick  ("
+              << (single_ms / tick_ms) << "x)  "
+              << (checksum == single_checksum ? "identical" : "DIFFERENT") << " to 1 thread"
+              << std::endl;
+  }
+}
+
+
+void bench_keybinds()
+{
+  constexpr int num_bindings = 256;
+  constexpr int num_lookups = 1000000;
+
+  std::cout << "Inventory with " << num_bindings << " key bindings" << std::endl;
+
+  Game game;
+
+  // Every scancode and mouse button, shuffled, first num_bindings get bound
+  std::vector<int> inputs;
+  for (int i = 0; i < NUM_SCANCODES; i++) inputs.push_back(i);
+  for (int b = 1; b < NUM_MOUSE_BUTTONS; b++) inputs.push_back(MouseButtonInput(b));
+  for (int i = int(inputs.size()) - 1; i > 0; i--)
+  {
+    std::swap(inputs[i], inputs[game.random.Int(0, i)]);
+  }
+
+  std::map<int, Item> old_inventory;
+  KeyBindTable inventory;
+  for (int i = 0; i < num_bindings; i++)
+  {
+    Item item = game.item_factory.GenerateRandomItem();
+    old_inventory.insert({inputs[i], item});
+    inventory.Bind(inputs[i], item);
+  }
+
+  std::vector<int> presses;
+  for (int i = 0; i < num_lookups; i++)
+  {
+    presses.push_back(inputs[game.random.Int(0, int(inputs.size()) - 1)]);
+  }
+
+  // Sum the damage of whatever is bound, so the lookups can't be optimised away
+  long map_damage = 0;
+  double map_lookup_ms = TimeAverageMs([&] {
+    map_damage = 0;
+    for (int key : presses)
+    {
+      auto it = old_inventory.find(key);
+      if (it != old_inventory.end()) map_damage += it->second.projectile_damage;
+    }
+  });
+
+  long table_damage = 0;
+  double table_lookup_ms = TimeAverageMs([&] {
+    table_damage = 0;
+    for (int key : presses)
+    {
+      const Item *item = inventory.Find(key);
+      if (item != nullptr) table_damage += item->projectile_damage;
+    }
+  });
+
+  std::cout << "  " << num_lookups << " key presses:"
+            << "  std::map " << map_lookup_ms << "ms"
+            << "  KeyBindTable " << table_lookup_ms << "ms"
+            << "  (checksums " << map_damage << " " << table_damage << ")" << std::endl;
+
+  int map_ready = 0;
+  double map_walk_ms = TimeAverageMs([&] {
+    map_ready = 0;
+    for (auto &it : old_inventory)
+    {
+      if (it.second.CanActivate(game.gamestate.wallclock)) map_ready++;
+    }
+  });
+
+  int table_ready = 0;
+  double table_walk_ms = TimeAverageMs([&] {
+    table_ready = 0;
+    for (auto &binding : inventory)
+    {
+      if (binding.item.CanActivate(game.gamestate.wallclock)) table_ready++;
+    }
+  });
+
+  std::cout << "  Walk over every binding:"
+            << "  std::map " << (map_walk_ms * 1000.0) << "us"
+            << "  KeyBindTable " << (table_walk_ms * 1000.0) << "us"
+            << "  (" << map_ready << " " << table_ready << " ready)" << std::endl;
+}
+
+
+void bench_snapshot()
+{
+  constexpr int num_items = 50000;
+  constexpr int num_monsters = 100000;
+  constexpr int num_projectiles = 100000;
+  const std::string filename = "bench_snapshot.snap";
+
+  std::cout << "Snapshot of " << num_items << " items, " << num_monsters << " monsters and "
+            << num_projectiles << " projectiles" << std::endl;
+
+  Game game;
+  game.NewGame();
+
+  auto time_start = std::chrono::steady_clock::now();
+  FillArena(game, num_projectiles, num_monsters);
+  for (int i = 0; i < num_items; i++)
+  {
+    game.gamestate.world_items.Insert(game.GenerateRandomItem(game.random.Position({0.0f, 0.0f}, {5000.0f, 5000.0f})));
+  }
+  std::chrono::duration<double> generate_time = std::chrono::steady_clock::now() - time_start;
+  const double generate_ms = generate_time.count() * 1000.0;
+
+  size_t bytes = 0;
+  double write_ms = TimeAverageMs([&] { bytes = WriteSnapshot(game.gamestate).size(); });
+
+  SaveSnapshot(game.gamestate, filename);
+
+  GameState loaded;
+  double load_ms = TimeAverageMs([&] { LoadSnapshot(filename, loaded); });
+  std::remove(filename.c_str());
+
+  const bool same = StateChecksum(loaded) == StateChecksum(game.gamestate);
+
+  std::cout << "  generate " << generate_ms << "ms  write " << write_ms << "ms  ("
+            << (bytes / (1024.0 * 1024.0)) << "MB)  mmap load " << load_ms << "ms  "
+            << (same ? "identical" : "DIFFERENT") << " to the original" << std::endl;
+}
+
+
+void bench_rewind()
+{
+  constexpr int seconds = 10;
+  constexpr int tick_rate = 120;
+  constexpr int ticks = seconds * tick_rate * 2;
+
+  std::cout << "Rewind buffer holding " << seconds << "s at " << tick_rate << " ticks/s" << std::endl;
+
+  for (int count : {0, 1000, 10000})
+  {
+    Game game;
+    game.Seed(1, 2);
+    game.NewGame();
+    if (count > 0) FillArena(game, count, count);
+
+    // Expire now and then, so there are spawns and removals to store
+    for (int i = 0; i < game.gamestate.world_projectiles.size(); i++)
+    {
+      game.gamestate.world_projectiles.expire_time[i] = game.random.Float(1.0f, 20.0f);
+    }
+    game.gamestate.world_projectiles.RebuildSlots(game.gamestate.wallclock);
+
+    RewindBuffer rewind{seconds * tick_rate};
+    std::vector<uint64_t> checksums;
+
+    double tick_seconds = 0.0;
+    double record_seconds = 0.0;
+    for (int t = 0; t < ticks; t++)
+    {
+      auto time_start = std::chrono::steady_clock::now();
+      game.Tick(BENCH_DT);
+      auto time_ticked = std::chrono::steady_clock::now();
+      rewind.Record(t, game.gamestate);
+      auto time_recorded = std::chrono::steady_clock::now();
+
+      tick_seconds += std::chrono::duration<double>(time_ticked - time_start).count();
+      record_seconds += std::chrono::duration<double>(time_recorded - time_ticked).count();
+      checksums.push_back(StateChecksum(game.gamestate));
+    }
+
+    const double history_seconds = double(rewind.Ticks()) / tick_rate;
+    const double kb_per_second = rewind.MemoryUsed() / 1024.0 / history_seconds;
+
+    // Go back to the oldest tick kept, and check re-simulating ends up in the same place
+    const long from = rewind.OldestTick();
+    Game resim;
+    auto time_start = std::chrono::steady_clock::now();
+    bool restored = rewind.Restore(from, resim.gamestate);
+    std::chrono::duration<double> restore_time = std::chrono::steady_clock::now() - time_start;
+
+    bool same = restored and StateChecksum(resim.gamestate) == checksums[from];
+    for (long t = from + 1; t < ticks; t++)
+    {
+      resim.Tick(BENCH_DT);
+      same = same and StateChecksum(resim.gamestate) == checksums[t];
+    }
+
+    std::cout << "  " << count << " x " << count << ":  "
+              << kb_per_second << "KB per second of history  "
+              << (record_seconds * 1e6 / ticks) << "us to record a tick  ("
+              << (100.0 * record_seconds / tick_seconds) << "% of the tick)  "
+              << (restore_time.count() * 1000.0) << "ms to restore  re-simulated "
+              << (same ? "identically" : "DIFFERENTLY") << std::endl;
+  }
+}
+
+
+void bench_pool()
+{
+  constexpr int capacity = 65536;
+  constexpr int spawns_per_tick = 500;
+  constexpr int ticks = 600;
+  constexpr float ttl = 2.0f; // Sustained fire needs 120000 slots, so the pool overflows
+
+  std::cout << "Sustained fire, " << spawns_per_tick << " projectiles per tick for " << ticks
+            << " ticks, " << capacity << " capacity" << std::endl;
+
+  Random random(1);
+  std::vector<Projectile> spawns;
+  for (int i = 0; i < spawns_per_tick; i++)
+  {
+    Projectile p;
+    p.position = p.last_position = random.Position({0.0f, 0.0f}, {1000.0f, 1000.0f});
+    p.velocity = angle_to_vec2(random.Float(0.0f, TWO_PI), 800.0f);
+    p.radius = 20.0f;
+    p.damage = 1;
+    spawns.push_back(p);
+  }
+
+  // The old way, a vector of structs with remove_if
+  double vector_ms = TimeAverageMs([&] {
+    std::vector<Projectile> projectiles;
+    for (int t = 0; t < ticks; t++)
+    {
+      const float now = t * BENCH_DT;
+      for (auto p : spawns)
+      {
+        p.expire_time = now + ttl;
+        if (int(projectiles.size()) < capacity) projectiles.push_back(p);
+      }
+      for (auto &p : projectiles)
+      {
+        p.last_position = p.position;
+        p.position += p.velocity * BENCH_DT;
+      }
+      remove_if_inplace(projectiles, [&](const Projectile &p) { return p.expire_time <= now; });
+    }
+  });
+
+  std::cout << "  std::vector + remove_if:  " << (vector_ms / ticks) << "ms/tick" << std::endl;
+
+  for (Overflow_Policy policy : {Overflow_Policy::refuse, Overflow_Policy::drop_oldest})
+  {
+    ProjectileStore store(capacity, policy);
+    double pool_ms = TimeAverageMs([&] {
+      store.clear();
+      store.ResetCounters();
+      for (int t = 0; t < ticks; t++)
+      {
+        const float now = t * BENCH_DT;
+        for (auto p : spawns)
+        {
+          p.expire_time = now + ttl;
+          store.Add(p);
+        }
+        store.Integrate(BENCH_DT);
+        store.RemoveExpired(now);
+      }
+    });
+
+    const ProjectileStore::Counters &c = store.GetCounters();
+    std::cout << "  pool (" << (policy == Overflow_Policy::refuse ? "refuse" : "drop oldest") << "):  "
+              << (pool_ms / ticks) << "ms/tick  peak " << c.peak << "  spawned " << c.spawned
+              << "  dropped " << c.dropped << "  refused " << c.refused << std::endl;
+  }
+}
+
+
+void bench_timers()
+{
+  constexpr int count = 100000;
+  constexpr int ticks = 2400;
+
+  std::cout << count << " things with 1-20s lifetimes, over " << ticks << " ticks" << std::endl;
+
+  Random random(1);
+  std::vector<float> expire_time;
+  for (int i = 0; i < count; i++)
+  {
+    expire_time.push_back(random.Float(1.0f, 20.0f));
+  }
+
+  // Checking every one of them every tick
+  long scan_fired = 0;
+  double scan_ms = TimeAverageMs([&] {
+    std::vector<uint8_t> alive(count, 1);
+    scan_fired = 0;
+    for (int t = 0; t < ticks; t++)
+    {
+      const float now = t * BENCH_DT;
+      for (int i = 0; i < count; i++)
+      {
+        if (alive[i] and expire_time[i] <= now)
+        {
+          alive[i] = 0;
+          scan_fired++;
+        }
+      }
+    }
+  });
+
+  long wheel_fired = 0;
+  double wheel_ms = TimeAverageMs([&] {
+    TimerWheel<int> wheel;
+    wheel.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+      wheel.Schedule(TimerTick(expire_time[i]), i);
+    }
+
+    wheel_fired = 0;
+    for (int t = 0; t < ticks; t++)
+    {
+      // Same as ProjectileStore, a timer can go off a little early within its wheel tick
+      const float now = t * BENCH_DT;
+      wheel.Advance(TimerTick(now), [&](int i) {
+        if (expire_time[i] > now) return wheel.Schedule(TimerTick(expire_time[i]) + 1, i);
+        wheel_fired++;
+      });
+    }
+  });
+
+  std::cout << "  scan every tick:  " << (scan_ms / ticks) << "ms/tick  (" << scan_fired << " expired)" << std::endl;
+  std::cout << "  timer wheel:  " << (wheel_ms / ticks) << "ms/tick, including scheduling  ("
+            << wheel_fired << " expired)" << std::endl;
+
+  // A new game's monsters, arriving through GameState::monster_spawns
+  Game game;
+  game.scene.num_monsters = 1000;
+  game.NewGame();
+  game.gamestate.player.health = {1000000, 1000000};
+
+  GameState &state = game.gamestate;
+  const int scheduled = state.monster_spawns.size();
+  int arrival_ticks = 0;
+  while (not state.monster_spawns.empty() and arrival_ticks < ticks)
+  {
+    game.Update(BENCH_DT);
+    arrival_ticks++;
+  }
+
+  std::cout << "  monster spawns:  " << scheduled << " scheduled, " << state.world_monsters.size()
+            << " arrived after " << (arrival_ticks * BENCH_DT) << "s"
+            << (state.world_monsters.size() == game.scene.num_monsters ? "" : "  MISSING") << std::endl;
+}
+
+
+void bench_flowfield()
+{
+  std::cout << "Melee monsters chasing a player walking in a circle" << std::endl;
+
+  for (int count : {1000, 5000, 20000})
+  {
+    Game game;
+    const float size = MeleeArena(game, count);
+    const vec2 centre{size * 0.5f, size * 0.5f};
+    GameState &state = game.gamestate;
+
+    // One search from scratch, which is what every monster would pay doing its own
+    double search_ms = TimeAverageMs([&] {
+      game.melee_field.Invalidate();
+      game.melee_field.Update(game.world_grid, centre);
+    });
+
+    int tick = 0;
+    const long builds_before = game.melee_field.Builds();
+    double tick_ms = TimeAverageMs([&] {
+      state.player.position = centre + angle_to_vec2(tick++ * BENCH_DT, size * 0.25f);
+      game.Update(BENCH_DT);
+    });
+    const long builds = game.melee_field.Builds() - builds_before;
+
+    std::cout << "  " << count << " monsters, " << game.world_grid.Cells() << " cells:"
+              << "  one search " << search_ms << "ms"
+              << "  (a search each would be " << (search_ms * count) << "ms/tick)"
+              << "  full Game::Update " << tick_ms << "ms, field rebuilt on " << builds << " of " << tick << " ticks"
+              << std::endl;
+  }
+}
+
+
+void bench_sight()
+{
+  constexpr int ai_rate = 10;
+  constexpr int tick_rate = 120;
+
+  std::cout << "Shooter line of sight to the player, over a grid with 1 in 10 cells blocked" << std::endl;
+
+  for (int count : {1000, 5000, 20000})
+  {
+    Game game;
+    game.NewGame();
+    FillArena(game, 0, count);
+
+    const float size = ArenaSize(count);
+    const vec2 centre{size * 0.5f, size * 0.5f};
+    game.world_grid.Resize({0.0f, 0.0f}, {size, size}, 40.0f);
+    for (int i = 0; i < game.world_grid.Cells() / 10; i++)
+    {
+      game.world_grid.SetBlocked(game.random.Position({0.0f, 0.0f}, {size, size}), true);
+    }
+
+    std::vector<vec2> positions;
+    for (auto &monster : game.gamestate.world_monsters)
+    {
+      positions.push_back(monster.position);
+    }
+
+    int visible = 0;
+    double serial_ms = TimeAverageMs([&] {
+      visible = 0;
+      for (const vec2 &position : positions)
+      {
+        visible += game.world_grid.LineOfSight(position, centre);
+      }
+    });
+
+    std::vector<uint8_t> sight(positions.size());
+    double batch_ms = TimeAverageMs([&] {
+      game.thread_pool->ParallelFor(int(positions.size()), 256, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+          sight[i] = game.world_grid.LineOfSight(positions[i], centre);
+        }
+      });
+    });
+
+    std::cout << "  " << count << " shooters (" << visible << " can see):"
+              << "  " << (count / serial_ms / 1000.0) << "M rays/s on one thread"
+              << "  " << (count / batch_ms / 1000.0) << "M rays/s batched over " << game.thread_pool->NumThreads() << " threads"
+              << "  every frame " << (serial_ms * tick_rate / 1000.0 * 100.0) << "% of a core"
+              << ", batched at " << ai_rate << "/s " << (batch_ms * ai_rate / 1000.0 * 100.0) << "%"
+              << std::endl;
+  }
+}
+
+
+// Pairs of monsters overlapping by more than a quarter of their size
+int CountCrowded(Game &game)
+{
+  const auto &monsters = game.gamestate.world_monsters;
+
+  SpatialGrid grid;
+  for (auto &monster : monsters)
+  {
+    grid.Add(monster.position, monster.radius * 0.75f);
+  }
+  grid.Build();
+
+  int crowded = 0;
+  for (int i = 0; i < monsters.size(); i++)
+  {
+    grid.QueryOverlaps(grid.Position(i), grid.Radius(i), [&](int other) { crowded += other > i; });
+  }
+  return crowded;
+}
+
+
+void bench_crowd()
+{
+  constexpr int ticks = 240;
+
+  std::cout << "Melee monsters separating while they chase the player" << std::endl;
+
+  for (int count : {5000, 20000})
+  {
+    Game game;
+    MeleeArena(game, count);
+    GameState &state = game.gamestate;
+
+    game.Update(BENCH_DT);
+    const int crowded_before = CountCrowded(game);
+
+    // Just the steering, over the grid built by the last update
+    std::vector<vec2> push(state.world_monsters.size());
+    double grid_ms = TimeAverageMs([&] {
+      game.thread_pool->ParallelFor(int(push.size()), 1024, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+          push[i] = game.Separation(i);
+        }
+      });
+    });
+
+    // Every monster against every other
+    auto time_start = std::chrono::steady_clock::now();
+    const auto &monsters = state.world_monsters;
+    for (int i = 0; i < monsters.size(); i++)
+    {
+      vec2 sum{0.0f, 0.0f};
+      for (int j = 0; j < monsters.size(); j++)
+      {
+        if (i != j and game.Collides(monsters[i].position, monsters[i].radius, monsters[j].position, monsters[j].radius))
+        {
+          sum += monsters[i].position - monsters[j].position;
+        }
+      }
+      push[i] = sum;
+    }
+    std::chrono::duration<double> all_pairs = std::chrono::steady_clock::now() - time_start;
+
+    time_start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks; t++)
+    {
+      game.Update(BENCH_DT);
+    }
+    std::chrono::duration<double> run_time = std::chrono::steady_clock::now() - time_start;
+
+    std::cout << "  " << count << " monsters:  separation " << grid_ms << "ms/tick  (all pairs "
+              << (all_pairs.count() * 1000.0) << "ms)  full Game::Update " << (run_time.count() * 1000.0 / ticks)
+              << "ms  crowded pairs " << crowded_before << " -> " << CountCrowded(game) << " after " << ticks
+              << " ticks" << std::endl;
+  }
+}
+
+
+void bench_lod()
+{
+  constexpr int ticks = 240;
+
+  std::cout << "Melee monsters at the same density in bigger and bigger levels, player in the middle" << std::endl;
+
+  for (int count : {1000, 10000, 50000})
+  {
+    double tick_ms[2];
+    for (bool lod : {false, true})
+    {
+      Game game;
+      MeleeArena(game, count);
+      game.monster_lod = lod;
+
+      auto time_start = std::chrono::steady_clock::now();
+      for (int t = 0; t < ticks; t++)
+      {
+        game.Update(BENCH_DT);
+      }
+      std::chrono::duration<double> run_time = std::chrono::steady_clock::now() - time_start;
+      tick_ms[lod] = run_time.count() * 1000.0 / ticks;
+    }
+
+    std::cout << "  " << count << " monsters:  every monster every tick " << tick_ms[0] << "ms/tick"
+              << "  by distance " << tick_ms[1] << "ms/tick  (" << (tick_ms[0] / tick_ms[1]) << "x)" << std::endl;
+  }
+}
+
+
+void bench_items()
+{
+  constexpr int queries = 1000;
+  constexpr int k = 8;
+
+  std::cout << "Finding items near the player and the mouse, with loot scattered over bigger and bigger levels"
+            << std::endl;
+
+  for (int count : {1000, 10000, 50000})
+  {
+    Game game;
+    game.NewGame();
+
+    const float size = ArenaSize(count);
+    auto &items = game.gamestate.world_items;
+    items.clear();
+    for (int i = 0; i < count; i++)
+    {
+      items.Insert(game.GenerateRandomItem(game.random.Position({0.0f, 0.0f}, {size, size})));
+    }
+
+    std::vector<vec2> points;
+    for (int q = 0; q < queries; q++)
+    {
+      points.push_back(game.random.Position({0.0f, 0.0f}, {size, size}));
+    }
+
+    CircleList circles;
+    for (auto &item : items)
+    {
+      circles.Add(item.position, item.radius);
+    }
+
+    KdTree tree;
+    double build_ms = TimeAverageMs([&] {
+      tree.Clear();
+      for (auto &item : items)
+      {
+        tree.Add(item.position, item.radius);
+      }
+      tree.Build();
+    });
+
+    // Everything in reach of each point, as the tree and as one batch over all of them
+    constexpr float reach = 60.0f;
+    long tree_found = 0;
+    double tree_ms = TimeAverageMs([&] {
+      tree_found = 0;
+      for (const vec2 &point : points)
+      {
+        tree.QueryOverlaps(point, reach, [&](int) { tree_found++; });
+      }
+    });
+
+    long batch_found = 0;
+    std::vector<uint64_t> hits;
+    double batch_ms = TimeAverageMs([&] {
+      batch_found = 0;
+      for (const vec2 &point : points)
+      {
+        OverlapBatch(point, reach, circles, hits);
+        ForEachHit(hits.data(), circles.size(), [&](int) { batch_found++; });
+      }
+    });
+
+    // Nearest k against sorting all of them, on a few of the points
+    std::vector<int> found;
+    double nearest_ms = TimeAverageMs([&] {
+      for (const vec2 &point : points)
+      {
+        tree.Nearest(point, k, size, found);
+      }
+    });
+
+    bool nearest_same = true;
+    std::vector<std::pair<float, int>> sorted(count);
+    for (int q = 0; q < 20; q++)
+    {
+      tree.Nearest(points[q], k, size, found);
+      for (int i = 0; i < count; i++)
+      {
+        const float dx = circles.x[i] - points[q].x;
+        const float dy = circles.y[i] - points[q].y;
+        sorted[i] = {dx * dx + dy * dy, i};
+      }
+      std::partial_sort(sorted.begin(), sorted.begin() + k, sorted.end());
+      for (int n = 0; n < k; n++)
+      {
+        nearest_same = nearest_same and found[n] == sorted[n].second;
+      }
+    }
+
+    std::cout << "  " << count << " items:  build " << build_ms << "ms"
+              << "  in reach " << (tree_ms * 1000.0 / queries) << "us/query (all of them "
+              << (batch_ms * 1000.0 / queries) << "us, " << (tree_found == batch_found ? "same" : "DIFFERENT") << ")"
+              << "  " << k << " nearest " << (nearest_ms * 1000.0 / queries) << "us/query ("
+              << (nearest_same ? "same" : "DIFFERENT") << " as sorting)" << std::endl;
+  }
+}
+
+
+void bench_tunnel()
+{
+  constexpr int count = 10000;
+  constexpr float speed = 800.0f;
+  constexpr float projectile_radius = 5.0f;
+  constexpr float monster_radius = 15.0f;
+
+  std::cout << count << " projectiles at " << speed << "px/s for a second, through a sparse field of "
+            << (monster_radius * 2.0f) << "px monsters" << std::endl;
+
+  Random random(1);
+
+  SpatialGrid monsters;
+  for (int i = 0; i < 200; i++)
+  {
+    monsters.Add(random.Position({0.0f, 0.0f}, {4000.0f, 4000.0f}), monster_radius);
+  }
+  monsters.Build();
+
+  std::vector<vec2> starts, velocities;
+  for (int i = 0; i < count; i++)
+  {
+    starts.push_back(random.Position({1000.0f, 1000.0f}, {3000.0f, 3000.0f}));
+    velocities.push_back(angle_to_vec2(random.Float(0.0f, 6.2831853f), speed));
+  }
+
+  for (float dt : {1.0f / 120.0f, 1.0f / 30.0f, 1.0f / 10.0f, 1.0f / 4.0f})
+  {
+    const int ticks = int(std::lround(1.0f / dt));
+
+    int landed_hits = 0;
+    int swept_hits = 0;
+    auto time_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+      bool landed = false;
+      bool swept = false;
+      for (int t = 0; t < ticks and not (landed and swept); t++)
+      {
+        const vec2 start = starts[i] + velocities[i] * (t * dt);
+        const vec2 stop = start + velocities[i] * dt;
+
+        monsters.QueryOverlaps(stop, projectile_radius, [&](int) { landed = true; });
+
+        const vec2 middle = (start + stop) * 0.5f;
+        monsters.QueryOverlaps(middle, distance(start, stop) * 0.5f + projectile_radius, [&](int index) {
+          swept = swept or SweptCircleTime(start, stop, projectile_radius, monsters.Position(index), monster_radius) >= 0.0f;
+        });
+      }
+      landed_hits += landed;
+      swept_hits += swept;
+    }
+    std::chrono::duration<double> run_time = std::chrono::steady_clock::now() - time_start;
+
+    std::cout << "  " << ticks << " ticks/s  (" << (speed * dt) << "px per tick):  hits tested where it lands "
+              << landed_hits << "  swept " << swept_hits << "  (" << (run_time.count() * 1000.0) << "ms for both)"
+              << std::endl;
+  }
+}
+
+
+// Everything in every stack in the world
+int CountWorldItems(const Game &game)
+{
+  int total = 0;
+  for (auto &item : game.gamestate.world_items)
+  {
+    total += item.count;
+  }
+  return total;
+}
+
+
+void bench_physics()
+{
+  constexpr int thrown = 300;
+  constexpr int ticks = 240;
+
+  std::cout << thrown << " items thrown into a field of loot, until they all go to sleep" << std::endl;
+
+  for (int lying : {1000, 20000})
+  {
+    const float size = ArenaSize(lying);
+    Game game;
+    game.NewGame();
+
+    GameState &state = game.gamestate;
+    state.world_items.clear();
+    for (int i = 0; i < lying; i++)
+    {
+      state.world_items.Insert(game.GenerateRandomItem(game.random.Position({0.0f, 0.0f}, {size, size})));
+    }
+    state.player.position = state.player.last_position = {-1000.0f, -1000.0f};
+
+    // Updates without anything moving, for comparison
+    double still_ms = TimeAverageMs([&] { game.Update(BENCH_DT); });
+
+    const vec2 centre{size * 0.5f, size * 0.5f};
+    for (int i = 0; i < thrown; i++)
+    {
+      Item item = game.GenerateRandomItem(centre);
+      item.velocity = angle_to_vec2(game.random.Float(0.0f, 6.2831853f), game.random.Float(100.0f, 1000.0f));
+      item.awake = true;
+      game.AddWorldItem(item);
+    }
+    const int total_before = CountWorldItems(game);
+
+    // Part way through, carried on from a snapshot as well
+    Game copy;
+    int settle_ticks = 0;
+    auto time_start = std::chrono::steady_clock::now();
+    while (not state.awake_items.empty() and settle_ticks < 10 * ticks)
+    {
+      if (settle_ticks == 5)
+      {
+        const std::vector<char> snapshot = WriteSnapshot(state);
+        ReadSnapshot(snapshot.data(), snapshot.size(), copy.gamestate);
+      }
+      if (settle_ticks >= 5) copy.Update(BENCH_DT);
+
+      game.Update(BENCH_DT);
+      settle_ticks++;
+    }
+    std::chrono::duration<double> settle_time = std::chrono::steady_clock::now() - time_start;
+    const bool same = StateChecksum(copy.gamestate) == StateChecksum(state);
+
+    double settled_ms = TimeAverageMs([&] { game.Update(BENCH_DT); });
+
+    std::cout << "  " << lying << " lying around:  " << settle_ticks << " ticks to settle at "
+              << (settle_time.count() * 1000.0 / settle_ticks) << "ms/tick (with the copy)"
+              << "  update " << still_ms << "ms before, " << settled_ms << "ms after"
+              << "  items " << total_before << " -> " << CountWorldItems(game)
+              << "  snapshot copy " << (same ? "identical" : "DIFFERENT")
+              << std::endl;
+  }
+}
+
+
+void bench_walls()
+{
+  constexpr int count = 10000;
+  constexpr float radius = 15.0f;
+  constexpr float speed = 800.0f;
+
+  std::cout << count << " circles pushed out of and swept against walls, BVH against testing every segment"
+            << std::endl;
+
+  for (int rooms : {4, 16, 32})
+  {
+    Random random(1);
+
+    // A grid of rooms, each ringed by walls with a gap in one side
+    const float room_size = 400.0f;
+    const float world_size = room_size * rooms;
+    std::vector<Segment> segments;
+    for (int ry = 0; ry < rooms; ry++)
+    {
+      for (int rx = 0; rx < rooms; rx++)
+      {
+        const vec2 corner{rx * room_size, ry * room_size};
+        const int gap = random.Int(0, 3);
+        for (int side = 0; side < 4; side++)
+        {
+          const vec2 a = corner + vec2{side == 1 or side == 2 ? room_size : 0.0f, side >= 2 ? room_size : 0.0f};
+          const vec2 b = corner + vec2{side == 0 or side == 1 ? room_size : 0.0f, side == 1 or side == 2 ? room_size : 0.0f};
+          const vec2 along = (b - a) * 0.25f;
+          for (int piece = 0; piece < 4; piece++)
+          {
+            if (side == gap and (piece == 1 or piece == 2)) continue;
+            segments.push_back({a + along * float(piece), a + along * float(piece + 1)});
+          }
+        }
+      }
+    }
+
+    SegmentBVH walls;
+    walls.Build(segments);
+
+    std::vector<float> start_x, start_y, stop_x, stop_y;
+    for (int i = 0; i < count; i++)
+    {
+      const vec2 start = random.Position({0.0f, 0.0f}, {world_size, world_size});
+      const vec2 stop = start + angle_to_vec2(random.Float(0.0f, 6.2831853f), speed * BENCH_DT);
+      start_x.push_back(start.x);
+      start_y.push_back(start.y);
+      stop_x.push_back(stop.x);
+      stop_y.push_back(stop.y);
+    }
+
+    std::vector<float> brute_times(count), times(count);
+    double brute_ms = TimeAverageMs([&] {
+      for (int i = 0; i < count; i++)
+      {
+        float first = -1.0f;
+        for (const Segment &s : segments)
+        {
+          const float t = SegmentBVH::SegmentSweepTime(s, {start_x[i], start_y[i]}, {stop_x[i], stop_y[i]}, radius);
+          if (t >= 0.0f and (first < 0.0f or t < first)) first = t;
+        }
+        brute_times[i] = first;
+      }
+    });
+
+    double sweep_ms = TimeAverageMs([&] {
+      for (int i = 0; i < count; i++)
+      {
+        times[i] = walls.SweepTime({start_x[i], start_y[i]}, {stop_x[i], stop_y[i]}, radius);
+      }
+    });
+
+    int hits = 0;
+    int mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+      hits += times[i] >= 0.0f;
+      mismatches += times[i] != brute_times[i];
+    }
+
+    std::vector<vec2> pushed(count);
+    double push_ms = TimeAverageMs([&] {
+      for (int i = 0; i < count; i++)
+      {
+        pushed[i] = walls.PushOut({start_x[i], start_y[i]}, radius);
+      }
+    });
+
+    int still_touching = 0;
+    for (const vec2 &position : pushed)
+    {
+      walls.QueryCircle(position, radius * 0.99f, [&](int) { still_touching++; });
+    }
+
+    std::cout << "  " << segments.size() << " segments:  sweep every segment " << brute_ms << "ms, BVH "
+              << sweep_ms << "ms  (" << hits << " hits, " << (mismatches ? "MISMATCHED" : "same") << ")"
+              << "  push out " << push_ms << "ms  (" << still_touching << " left touching)" << std::endl;
+  }
+}
+
+
+void bench_chunks()
+{
+  constexpr float speed = 600.0f;
+  constexpr int seconds_out = 150;
+
+  std::cout << "Walking through a streamed world at " << speed << "px/s for " << seconds_out
+            << "s, then back again" << std::endl;
+
+  Game game;
+  game.Seed(1, 2);
+  game.scene.chunk_size = 1000.0f;
+  game.scene.num_items = 20;
+  game.scene.num_monsters = 10;
+  game.NewGame();
+
+  GameState &state = game.gamestate;
+  state.player.health = {1000000, 1000000};
+
+  // Carried on from a snapshot part way out, should end up the same
+  Game copy;
+  copy.scene = game.scene;
+
+  const int ticks_per_second = int(std::lround(1.0f / BENCH_DT));
+  auto time_start = std::chrono::steady_clock::now();
+  for (int second = 0; second < 2 * seconds_out; second++)
+  {
+    state.player.velocity = {second < seconds_out ? speed : -speed, 0.0f};
+    copy.gamestate.player.velocity = state.player.velocity;
+
+    double worst_ms = 0.0;
+    auto second_start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks_per_second; t++)
+    {
+      auto tick_start = std::chrono::steady_clock::now();
+      game.Update(BENCH_DT);
+      std::chrono::duration<double> tick_time = std::chrono::steady_clock::now() - tick_start;
+      worst_ms = std::max(worst_ms, tick_time.count() * 1000.0);
+
+      if (second >= 10) copy.Update(BENCH_DT);
+    }
+    std::chrono::duration<double> second_time = std::chrono::steady_clock::now() - second_start;
+
+    if (second == 9)
+    {
+      const std::vector<char> snapshot = WriteSnapshot(state);
+      ReadSnapshot(snapshot.data(), snapshot.size(), copy.gamestate);
+    }
+
+    if (second % 30 == 29)
+    {
+      std::cout << "  " << (second + 1) << "s  x " << int(state.player.position.x) << "  loaded "
+                << state.loaded_chunks.size() << " saved " << state.saved_chunks.size() << "  items "
+                << state.world_items.size() << " monsters " << state.world_monsters.size() << "  snapshot "
+                << WriteSnapshot(state).size() / 1024 << "KB  tick "
+                << (second_time.count() * 1000.0 / ticks_per_second) << "ms (with the copy)  worst " << worst_ms
+                << "ms" << std::endl;
+    }
+  }
+  std::chrono::duration<double> run_time = std::chrono::steady_clock::now() - time_start;
+
+  std::cout << "  " << (run_time.count() * 1000.0) << "ms in all  snapshot copy "
+            << (StateChecksum(copy.gamestate) == StateChecksum(state) ? "identical" : "DIFFERENT") << std::endl;
+}
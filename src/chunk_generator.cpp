@@ -0,0 +1,156 @@
+#include "chunk_generator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+
+uint32_t ChunkSeed(uint32_t world_seed, ChunkCoord coord)
+{
+  // splitmix64's finaliser, one coordinate at a time
+  auto mix = [](uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+  };
+
+  uint64_t h = mix(world_seed + 0x9E3779B97F4A7C15ull);
+  h = mix(h ^ uint32_t(coord.x));
+  h = mix(h ^ uint32_t(coord.y));
+  return uint32_t(h);
+}
+
+
+ChunkGenerator::ChunkGenerator(int num_threads)
+: num_threads(std::max(1, num_threads))
+{
+}
+
+
+ChunkGenerator::~ChunkGenerator()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  work_ready.notify_all();
+
+  for (auto &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+
+void ChunkGenerator::Reset(GenerateFunc func)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  generation++;
+  generate = std::move(func);
+  queue.clear();
+  in_progress.clear();
+  done.clear();
+}
+
+
+void ChunkGenerator::Request(ChunkCoord coord)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty())
+    {
+      for (int i = 0; i < num_threads; i++)
+      {
+        workers.emplace_back(&ChunkGenerator::WorkerLoop, this);
+      }
+    }
+
+    if (done.count(coord) or std::find(queue.begin(), queue.end(), coord) != queue.end() or
+        std::find(in_progress.begin(), in_progress.end(), coord) != in_progress.end())
+    {
+      return;
+    }
+    queue.push_back(coord);
+  }
+  work_ready.notify_one();
+}
+
+
+ChunkContents ChunkGenerator::Take(ChunkCoord coord)
+{
+  GenerateFunc func;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [&] { return std::find(in_progress.begin(), in_progress.end(), coord) == in_progress.end(); });
+
+    auto it = done.find(coord);
+    if (it != done.end())
+    {
+      ChunkContents contents = std::move(it->second);
+      done.erase(it);
+      return contents;
+    }
+
+    // Quicker to make it now than wait for its turn
+    queue.erase(std::remove(queue.begin(), queue.end(), coord), queue.end());
+    func = generate;
+  }
+
+  return func(coord);
+}
+
+
+void ChunkGenerator::Retain(ChunkCoord centre, int radius)
+{
+  auto far = [&](ChunkCoord coord) {
+    return std::abs(coord.x - centre.x) > radius or std::abs(coord.y - centre.y) > radius;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.erase(std::remove_if(queue.begin(), queue.end(), far), queue.end());
+  for (auto it = done.begin(); it != done.end();)
+  {
+    it = far(it->first) ? done.erase(it) : std::next(it);
+  }
+}
+
+
+int ChunkGenerator::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return int(queue.size() + in_progress.size() + done.size());
+}
+
+
+void ChunkGenerator::WorkerLoop()
+{
+  while (true)
+  {
+    ChunkCoord coord;
+    GenerateFunc func;
+    long job_generation;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      work_ready.wait(lock, [&] { return quitting or not queue.empty(); });
+      if (quitting) return;
+
+      coord = queue.front();
+      queue.pop_front();
+      in_progress.push_back(coord);
+      func = generate;
+      job_generation = generation;
+    }
+
+    ChunkContents contents = func(coord);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (job_generation == generation)
+      {
+        in_progress.erase(std::find(in_progress.begin(), in_progress.end(), coord));
+        done[coord] = std::move(contents);
+      }
+    }
+    work_done.notify_all();
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Generates the contents of world chunks on background threads, ahead of
+// the player getting to them.  What a chunk holds depends only on the seed
+// it's made from and where it is, never on when or which thread made it, so
+// the simulation stays deterministic however far behind the threads are.
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "game_types.hpp"
+#include "segment_bvh.hpp"
+
+
+struct ChunkContents
+{
+  std::vector<Segment> walls;
+  std::vector<Item> items;
+  std::vector<Monster> monsters;
+};
+
+
+// Seed for the chunk's own generator, so neighbours have nothing in common
+uint32_t ChunkSeed(uint32_t world_seed, ChunkCoord coord);
+
+
+class ChunkGenerator
+{
+public:
+  using GenerateFunc = std::function<ChunkContents(ChunkCoord coord)>;
+
+  // The threads are only started by the first Request()
+  explicit ChunkGenerator(int num_threads = 1);
+  ~ChunkGenerator();
+
+  ChunkGenerator(const ChunkGenerator &copy) = delete;
+  ChunkGenerator &operator=(const ChunkGenerator &copy) = delete;
+
+  // Forgets everything asked for so far, and makes chunks with func from now on
+  void Reset(GenerateFunc func);
+
+  // Starts making the chunk in the background, unless it already has been
+  void Request(ChunkCoord coord);
+
+  // Waits for the chunk if it's being made, or makes it here if it hasn't
+  // been started yet
+  ChunkContents Take(ChunkCoord coord);
+
+  // Drops chunks waiting to be made or taken more than radius chunks from centre
+  void Retain(ChunkCoord centre, int radius);
+
+  // Waiting to be made, being made, or made and waiting to be taken
+  int size() const;
+
+private:
+  int num_threads;
+  std::vector<std::thread> workers;
+
+  mutable std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+
+  bool quitting = false;
+
+  // Bumped by Reset(), so chunks started before then are thrown away
+  long generation = 0;
+  GenerateFunc generate;
+
+  std::deque<ChunkCoord> queue;
+  std::vector<ChunkCoord> in_progress;
+  std::map<ChunkCoord, ChunkContents> done;
+
+  void WorkerLoop();
+};
@@ -0,0 +1,185 @@
+#include "collision.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "simd.hpp"
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+void CircleList::clear()
+{
+  x.clear();
+  y.clear();
+  radius.clear();
+}
+
+
+void CircleList::resize(int count)
+{
+  x.resize(count);
+  y.resize(count);
+  radius.resize(count);
+}
+
+
+void CircleList::Add(vec2 position, float r)
+{
+  x.push_back(position.x);
+  y.push_back(position.y);
+  radius.push_back(r);
+}
+
+
+void CircleList::Set(int index, vec2 position, float r)
+{
+  x[index] = position.x;
+  y[index] = position.y;
+  radius[index] = r;
+}
+
+
+///////////////////////////////////////
+
+
+struct OverlapArgs
+{
+  vec2 position;
+  float radius;
+  const float *x;
+  const float *y;
+  const float *r;
+  uint64_t *hits;
+};
+
+
+// Handles whatever is left over after the SIMD loops too
+void OverlapScalar(const OverlapArgs &a, int begin, int end)
+{
+  for (int i = begin; i < end; i++)
+  {
+    const float dx = a.x[i] - a.position.x;
+    const float dy = a.y[i] - a.position.y;
+    const float radii = a.r[i] + a.radius;
+
+    if (dx * dx + dy * dy <= radii * radii)
+    {
+      a.hits[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+}
+
+
+#if SIMD_X86
+
+SIMD_TARGET_SSE2
+void OverlapSSE2(const OverlapArgs &a, int count)
+{
+  const __m128 px = _mm_set1_ps(a.position.x);
+  const __m128 py = _mm_set1_ps(a.position.y);
+  const __m128 pr = _mm_set1_ps(a.radius);
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(a.x + i), px);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(a.y + i), py);
+    __m128 radii = _mm_add_ps(_mm_loadu_ps(a.r + i), pr);
+
+    __m128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    int mask = _mm_movemask_ps(_mm_cmple_ps(dist2, _mm_mul_ps(radii, radii)));
+
+    a.hits[i / 64] |= uint64_t(mask) << (i % 64);
+  }
+
+  OverlapScalar(a, i, count);
+}
+
+
+SIMD_TARGET_AVX2
+void OverlapAVX2(const OverlapArgs &a, int count)
+{
+  const __m256 px = _mm256_set1_ps(a.position.x);
+  const __m256 py = _mm256_set1_ps(a.position.y);
+  const __m256 pr = _mm256_set1_ps(a.radius);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(a.x + i), px);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(a.y + i), py);
+    __m256 radii = _mm256_add_ps(_mm256_loadu_ps(a.r + i), pr);
+
+    __m256 dist2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    int mask = _mm256_movemask_ps(_mm256_cmp_ps(dist2, _mm256_mul_ps(radii, radii), _CMP_LE_OQ));
+
+    a.hits[i / 64] |= uint64_t(mask) << (i % 64);
+  }
+
+  OverlapScalar(a, i, count);
+}
+
+#endif
+
+
+void OverlapBatch(vec2 position, float radius,
+  const float *x, const float *y, const float *r, int count, uint64_t *hits)
+{
+  if (count <= 0) return;
+
+  std::memset(hits, 0, HitMaskWords(count) * sizeof(uint64_t));
+
+  OverlapArgs a{position, radius, x, y, r, hits};
+
+#if SIMD_X86
+  switch (GetSimdLevel())
+  {
+    case SimdLevel::avx2:
+      return OverlapAVX2(a, count);
+    case SimdLevel::sse2:
+      return OverlapSSE2(a, count);
+    case SimdLevel::scalar:
+      break;
+  }
+#endif
+
+  OverlapScalar(a, 0, count);
+}
+
+
+void OverlapBatch(vec2 position, float radius, const CircleList &circles, std::vector<uint64_t> &hits)
+{
+  hits.resize(HitMaskWords(circles.size()));
+  OverlapBatch(position, radius, circles.x.data(), circles.y.data(), circles.radius.data(), circles.size(), hits.data());
+}
+
+
+///////////////////////////////////////
+
+
+float SweptCircleTime(vec2 start, vec2 end, float radius, vec2 centre, float other_radius)
+{
+  // Solves |start + t * (end - start) - centre| = radius + other_radius for the first t
+  const float mx = start.x - centre.x;
+  const float my = start.y - centre.y;
+  const float dx = end.x - start.x;
+  const float dy = end.y - start.y;
+  const float radii = radius + other_radius;
+
+  const float c = mx * mx + my * my - radii * radii;
+  if (c <= 0.0f) return 0.0f;
+
+  // Heading away, or not moving
+  const float b = mx * dx + my * dy;
+  const float a = dx * dx + dy * dy;
+  if (b >= 0.0f or a == 0.0f) return -1.0f;
+
+  const float discriminant = b * b - a * c;
+  if (discriminant < 0.0f) return -1.0f;
+
+  const float t = (-b - std::sqrt(discriminant)) / a;
+  return t <= 1.0f ? t : -1.0f;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Batched circle overlap tests.
+// One circle is tested against a whole array of circles at once, using
+// squared distances (no sqrt), and the results come back as a bitmask.
+// Plus a swept test, for things that move further in a tick than they are wide.
+
+#include <cstdint>
+#include <vector>
+
+#include "maths_types.hpp"
+
+
+// Circles as a structure of arrays, so they can be tested in batches
+struct CircleList
+{
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> radius;
+
+  int size() const { return int(x.size()); }
+  void clear();
+  void resize(int count);
+  void Add(vec2 position, float r);
+  void Set(int index, vec2 position, float r);
+};
+
+
+// Number of 64 bit words needed for a hit mask of count circles
+constexpr int HitMaskWords(int count)
+{
+  return (count + 63) / 64;
+}
+
+
+// Sets bit i of hits if circle i overlaps (or touches) the query circle.
+// hits must have room for HitMaskWords(count) words, and is cleared first.
+void OverlapBatch(vec2 position, float radius,
+  const float *x, const float *y, const float *r, int count, uint64_t *hits);
+
+void OverlapBatch(vec2 position, float radius, const CircleList &circles, std::vector<uint64_t> &hits);
+
+
+// How far a circle moving from start to end gets before it first touches
+// another one, as a fraction of the way (0 if they already touch at the
+// start).  Negative if it never does.
+float SweptCircleTime(vec2 start, vec2 end, float radius, vec2 centre, float other_radius);
+
+
+// Calls func(index) for every bit set in the hit mask
+template<typename FUNC>
+void ForEachHit(const uint64_t *hits, int count, FUNC &&func)
+{
+  for (int word = 0; word < HitMaskWords(count); word++)
+  {
+    uint64_t bits = hits[word];
+    while (bits)
+    {
+      func(word * 64 + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+}
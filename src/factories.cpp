@@ -17,6 +17,13 @@ ItemFactory::ItemFactory()
     Item_Type::gun};
 
   monster_type_list = {Monster_Type::dummy, Monster_Type::melee, Monster_Type::shooter};
+
+  command_list = {{"UP", Command_Type::up},
+    {"DOWN", Command_Type::down},
+    {"LEFT", Command_Type::left},
+    {"RIGHT", Command_Type::right},
+    {"MENU", Command_Type::menu},
+    {"DROP", Command_Type::drop}};
 }
 
 
@@ -25,7 +32,9 @@ Item ItemFactory::GetCommand(std::string what)
   Item i;
   i.name = what;
 
-  i.CreateCommand(what);
+  // Looked up once here, so activating a command never compares strings
+  auto it = command_list.find(what);
+  i.CreateCommand(it == command_list.end() ? Command_Type::none : it->second);
   //   i.activate = Active_Type::hold_down;
   i.type = Item_Type::command;
 
@@ -34,35 +43,47 @@ Item ItemFactory::GetCommand(std::string what)
 
 
 Item ItemFactory::GenerateRandomItem()
+{
+  return GenerateRandomItem(random);
+}
+
+
+Monster ItemFactory::GenerateRandomMonster()
+{
+  return GenerateRandomMonster(random);
+}
+
+
+Item ItemFactory::GenerateRandomItem(Random &rng) const
 {
   Item i;
 
-  i.type = random.PickList(item_type_list);
+  i.type = rng.PickList(item_type_list);
 
   switch (i.type)
   {
     case Item_Type::gun:
       i.name = "Gun";
       i.radius = 15;
-      i.colour = random.ColourVarying({0.8f, 0.6f, 0.2f, 1.0f});
+      i.colour = rng.ColourVarying({0.8f, 0.6f, 0.2f, 1.0f});
 
-      i.CreateGun(random.Int(1, 5));
-      i.AddCooldown(random.Int(1, 2));
+      i.CreateGun(rng.Int(1, 5));
+      i.AddCooldown(rng.Int(1, 2));
 
       i.animation = "star";
-      i.animation_time = random.Float(0.0f, 1.0f);
+      i.animation_offset = rng.Float(0.0f, 1.0f);
       break;
 
     case Item_Type::health:
       i.name = "HealthKit";
       i.radius = 20;
-      i.colour = random.ColourVarying({0.8f, 0.2f, 0.2f, 1.0f});
+      i.colour = rng.ColourVarying({0.8f, 0.2f, 0.2f, 1.0f});
 
-      i.CreateHealing(random.Int(5, 20));
-      i.AddCooldown(random.Int(3, 10));
-      if (random.Percent() < 50)
+      i.CreateHealing(rng.Int(5, 20));
+      i.AddCooldown(rng.Int(3, 10));
+      if (rng.Percent() < 50)
       {
-        i.AddLimitedUses(random.Int(3, 10));
+        i.AddLimitedUses(rng.Int(3, 10));
       }
       break;
 
@@ -77,10 +98,10 @@ Item ItemFactory::GenerateRandomItem()
 }
 
 
-Monster ItemFactory::GenerateRandomMonster()
+Monster ItemFactory::GenerateRandomMonster(Random &rng) const
 {
   Monster m;
-  m.type = random.PickList(monster_type_list);
+  m.type = rng.PickList(monster_type_list);
 
   switch (m.type)
   {
@@ -92,7 +113,7 @@ Monster ItemFactory::GenerateRandomMonster()
 
     case Monster_Type::melee:
     {
-      int h = random.Int(1, 10);
+      int h = rng.Int(1, 10);
       m.health = {h, h};
       m.name = "Melee monster";
       m.radius = 40;
@@ -101,7 +122,7 @@ Monster ItemFactory::GenerateRandomMonster()
 
     case Monster_Type::shooter:
     {
-      int h = random.Int(1, 5);
+      int h = rng.Int(1, 5);
       m.health = {h, h};
       m.name = "Shooter monster";
       m.radius = 30;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "game_types.hpp"
@@ -10,6 +12,7 @@ class ItemFactory
 private:
   std::vector<Item_Type> item_type_list;
   std::vector<Monster_Type> monster_type_list;
+  std::map<std::string, Command_Type> command_list;
 
 public:
   Random random;
@@ -20,6 +23,10 @@ public:
 
   Monster GenerateRandomMonster();
 
+  // With rng instead of random, so safe to call from other threads
+  Item GenerateRandomItem(Random &rng) const;
+  Monster GenerateRandomMonster(Random &rng) const;
+
 
   Item GetCommand(std::string what);
 };
@@ -0,0 +1,120 @@
+#include "flow_field.hpp"
+
+#include <algorithm>
+
+#include "maths.hpp"
+
+
+// Orthogonal steps first, so ties go to the straight move
+const int NEIGHBOUR_X[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+const int NEIGHBOUR_Y[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+constexpr float DIAGONAL = 0.70710678f;
+const vec2 NEIGHBOUR_DIRECTION[8] = {
+  {1.0f, 0.0f}, {-1.0f, 0.0f}, {0.0f, 1.0f}, {0.0f, -1.0f},
+  {DIAGONAL, DIAGONAL}, {DIAGONAL, -DIAGONAL}, {-DIAGONAL, DIAGONAL}, {-DIAGONAL, -DIAGONAL}};
+
+
+bool FlowField::Update(const OccupancyGrid& grid, vec2 target)
+{
+  if (grid.Cells() == 0) return false;
+
+  const int cell = grid.CellAt(target);
+  if (cell == target_cell and grid.Version() == grid_version and int(distance.size()) == grid.Cells()) return false;
+
+  target_cell = cell;
+  grid_version = grid.Version();
+  Build(grid);
+  return true;
+}
+
+
+void FlowField::Build(const OccupancyGrid& grid)
+{
+  builds++;
+
+  const int columns = grid.Columns();
+  const int rows = grid.Rows();
+
+  distance.assign(grid.Cells(), -1);
+  direction.resize(grid.Cells());
+  queue.clear();
+
+  // 4 way search, so the distances are the number of orthogonal steps
+  distance[target_cell] = 0;
+  queue.push_back(target_cell);
+
+  for (unsigned head = 0; head < queue.size(); head++)
+  {
+    const int cell = queue[head];
+    const int cx = cell % columns;
+    const int cy = cell / columns;
+
+    for (int n = 0; n < 4; n++)
+    {
+      const int nx = cx + NEIGHBOUR_X[n];
+      const int ny = cy + NEIGHBOUR_Y[n];
+      if (nx < 0 or nx >= columns or ny < 0 or ny >= rows) continue;
+
+      const int next = ny * columns + nx;
+      if (grid.Blocked(next) or distance[next] >= 0) continue;
+
+      distance[next] = distance[cell] + 1;
+      queue.push_back(next);
+    }
+  }
+
+  // Unreachable cells go nowhere
+  std::fill(direction.begin(), direction.end(), vec2{0.0f, 0.0f});
+
+  // Then point each cell at its closest neighbour.  A diagonal step saves two
+  // orthogonal ones, so they win whenever both axes need to close, but only
+  // if neither corner is blocked.
+  for (int cell : queue)
+  {
+    const int cx = cell % columns;
+    const int cy = cell / columns;
+
+    int best = distance[cell];
+    vec2 best_direction{0.0f, 0.0f};
+
+    for (int n = 0; n < 8; n++)
+    {
+      const int nx = cx + NEIGHBOUR_X[n];
+      const int ny = cy + NEIGHBOUR_Y[n];
+      if (nx < 0 or nx >= columns or ny < 0 or ny >= rows) continue;
+
+      const int next = ny * columns + nx;
+      if (distance[next] < 0 or distance[next] >= best) continue;
+
+      if (n >= 4 and (grid.Blocked(nx, cy) or grid.Blocked(cx, ny))) continue;
+
+      best = distance[next];
+      best_direction = NEIGHBOUR_DIRECTION[n];
+    }
+
+    direction[cell] = best_direction;
+  }
+}
+
+
+vec2 FlowField::Direction(const OccupancyGrid& grid, vec2 position, vec2 target) const
+{
+  if (distance.empty()) return {0.0f, 0.0f};
+
+  const int cell = grid.CellAt(position);
+  if (cell == target_cell)
+  {
+    const vec2 diff = target - position;
+    return (diff.x == 0.0f and diff.y == 0.0f) ? diff : normalize(diff);
+  }
+
+  return direction[cell];
+}
+
+
+int FlowField::Distance(const OccupancyGrid& grid, vec2 position) const
+{
+  if (distance.empty()) return -1;
+  return distance[grid.CellAt(position)];
+}
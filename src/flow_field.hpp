@@ -0,0 +1,48 @@
+#pragma once
+
+// Flow field toward a single target, over an OccupancyGrid.
+// One breadth first search out from the target's cell gives every cell the
+// direction to step in, so any number of things can find their way to the
+// target for the price of a lookup each.  The search is only redone when the
+// target moves to a different cell, or the grid changes.
+
+#include <cstdint>
+#include <vector>
+
+#include "maths_types.hpp"
+#include "occupancy_grid.hpp"
+
+
+class FlowField
+{
+private:
+  // Steps to the target cell, -1 if it can't be reached
+  std::vector<int> distance;
+
+  // Unit vector toward the next cell on the way, zero at the target
+  std::vector<vec2> direction;
+
+  std::vector<int> queue;
+
+  int target_cell = -1;
+  uint32_t grid_version = 0;
+  long builds = 0;
+
+  void Build(const OccupancyGrid& grid);
+
+public:
+  // Searches again if the target has changed cell, or the grid has changed,
+  // since last time.  Returns true if it did.
+  bool Update(const OccupancyGrid& grid, vec2 target);
+
+  // Which way to go from position.  Heads straight for the target once in
+  // the same cell, and zero if there's no way there.
+  vec2 Direction(const OccupancyGrid& grid, vec2 position, vec2 target) const;
+
+  int Distance(const OccupancyGrid& grid, vec2 position) const;
+
+  // Forces a search at the next Update()
+  void Invalidate() { target_cell = -1; }
+
+  long Builds() const { return builds; }
+};
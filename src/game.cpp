@@ -3,10 +3,12 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <sstream>
 
+#include "collision.hpp"
 #include "maths.hpp"
-#include "sound.hpp"
+#include "snapshot.hpp"
 #include "to_string.hpp"
 #include "utils.hpp"
 
@@ -14,121 +16,891 @@
 
 
 constexpr bool DEBUG_INPUT = false;
+constexpr bool DEBUG_COMBAT = false;
+
+constexpr float MOUSE_RADIUS = 20.0f;
+
+// Entities per job when splitting the update across threads
+constexpr int UPDATE_CHUNK_SIZE = 1024;
+
+// Projectiles are preallocated, once full the oldest make way for new ones
+constexpr Overflow_Policy PROJECTILE_OVERFLOW = Overflow_Policy::drop_oldest;
+constexpr float PROJECTILE_LIFETIME = 2.0f;
+
+// Melee monsters path over a grid covering the world plus this much around it.
+// Cells get bigger in huge worlds, to keep the search quick.
+constexpr float FLOW_CELL_SIZE = 40.0f;
+constexpr float FLOW_FIELD_MARGIN = 400.0f;
+constexpr float FLOW_MAX_CELLS = 65536.0f;
+
+// Dropped items are thrown toward the mouse, and slide to a stop up to this far away
+constexpr float ITEM_THROW_RANGE = 250.0f;
+
+// Fraction of speed lost per second is 1 - e^-friction
+constexpr float ITEM_FRICTION = 4.0f;
+constexpr float ITEM_BOUNCE = 0.5f;
+
+// Items slower than this go to sleep, and need hitting faster than this to wake up
+constexpr float ITEM_SLEEP_SPEED = 10.0f;
+constexpr float ITEM_WAKE_SPEED = 50.0f;
+
+// Rebuild the item tree when more than 1 in this many items have moved since it was built
+constexpr int ITEM_TREE_MOVED_FRACTION = 8;
+
+// The world is ringed by walls, at least this far out from its edges
+constexpr float WALL_MARGIN = 60.0f;
+constexpr float WALL_SEGMENT_LENGTH = 80.0f;
+constexpr int WALL_MIN_SEGMENTS = 32;
+
+// Streamed worlds load the chunks this close to the player's, keep them until
+// they're further away than that, and start generating them from further out
+constexpr int CHUNK_LOAD_RADIUS = 1;
+constexpr int CHUNK_KEEP_RADIUS = 2;
+constexpr int CHUNK_PREFETCH_RADIUS = 3;
+constexpr int CHUNK_GENERATOR_THREADS = 2;
+
+// Chunks remembered once the player leaves, past this the oldest are forgotten
+constexpr int CHUNK_SAVED_MAX = 256;
+
+// Each chunk has up to this many straight walls
+constexpr int CHUNK_MAX_WALLS = 3;
+constexpr float CHUNK_WALL_LENGTH = 240.0f;
+
+// A new game's monsters arrive one after another over this many seconds
+constexpr float MONSTER_ARRIVAL_TIME = 5.0f;
+
+// Stray projectiles in a stress scene last up to this long
+constexpr float SCENE_PROJECTILE_LIFETIME = 10.0f;
+constexpr float MELEE_SPEED = 120.0f;
+
+// How fast overlapping monsters move apart, at most
+constexpr float SEPARATION_SPEED = 150.0f;
+
+// Monsters further from the player move every few ticks, in one bigger step
+constexpr float LOD_NEAR_DISTANCE = 1000.0f;
+constexpr float LOD_FAR_DISTANCE = 2500.0f;
+constexpr int LOD_MID_PERIOD = 4;
+constexpr int LOD_FAR_PERIOD = 16;
+
+// Shooters decide whether to fire this many times a second
+constexpr int SHOOTER_AI_RATE = 10;
+constexpr int SHOOTER_CHUNK_SIZE = 256;
+constexpr float SHOOTER_RANGE = 700.0f;
+constexpr float SHOOTER_COOLDOWN = 1.5f;
+constexpr float SHOOTER_PROJECTILE_SPEED = 400.0f;
 
 
 Game::Game()
+: chunk_generator(CHUNK_GENERATOR_THREADS)
+, thread_pool(std::make_unique<ThreadPool>())
 {
+  gamestate.world_projectiles.SetCapacity(DEFAULT_PROJECTILE_CAPACITY, PROJECTILE_OVERFLOW);
+
+  ResizeWorld();
 }
 
 
-void Game::UpdatePlayer(float dt)
+void Game::ResizeWorld()
 {
-  gamestate.player.position += (gamestate.player.velocity * dt);
+  std::vector<Segment> segments;
+  vec2 min, max;
+
+  const std::vector<ChunkCoord>& loaded = gamestate.loaded_chunks;
+  if (scene.chunk_size > 0.0f and not loaded.empty())
+  {
+    // The walls of the loaded chunks, made again for any loaded some other
+    // way, like from a snapshot
+    std::map<ChunkCoord, std::vector<Segment>> kept;
+    for (ChunkCoord coord : loaded)
+    {
+      auto it = chunk_walls.find(coord);
+      kept[coord] = it != chunk_walls.end() ? std::move(it->second)
+                                            : GenerateChunk(scene, gamestate.world_seed, coord).walls;
+      segments.insert(segments.end(), kept[coord].begin(), kept[coord].end());
+    }
+    chunk_walls = std::move(kept);
+    walled_chunks = loaded;
 
-  for (auto& it : gamestate.player.KeyBindInventory)
+    min = max = {float(loaded.front().x), float(loaded.front().y)};
+    for (ChunkCoord coord : loaded)
+    {
+      min = {std::min(min.x, float(coord.x)), std::min(min.y, float(coord.y))};
+      max = {std::max(max.x, float(coord.x + 1)), std::max(max.y, float(coord.y + 1))};
+    }
+    min = min * scene.chunk_size;
+    max = max * scene.chunk_size;
+  }
+  else
   {
-    UpdateItem(it.second, dt);
+    // A ring of walls, through the corners of the world plus a margin
+    const vec2 centre = (scene.world_min + scene.world_max) * 0.5f;
+    const vec2 half = (scene.world_max - scene.world_min) * 0.5f + vec2{WALL_MARGIN, WALL_MARGIN};
+    const vec2 radii = half * std::sqrt(2.0f);
+
+    const float perimeter = TWO_PI * std::sqrt((radii.x * radii.x + radii.y * radii.y) * 0.5f);
+    const int num_segments = std::max(WALL_MIN_SEGMENTS, int(perimeter / WALL_SEGMENT_LENGTH));
+
+    auto point = [&](int i) {
+      const float angle = TWO_PI * float(i % num_segments) / float(num_segments);
+      return vec2{centre.x + std::cos(angle) * radii.x, centre.y + std::sin(angle) * radii.y};
+    };
+    for (int i = 0; i < num_segments; i++)
+    {
+      segments.push_back({point(i), point(i + 1)});
+    }
+
+    min = centre - radii;
+    max = centre + radii;
   }
-}
+  walls.Build(segments);
 
+  const vec2 margin = {FLOW_FIELD_MARGIN, FLOW_FIELD_MARGIN};
+  min = min - margin;
+  max = max + margin;
 
-void Game::UpdateItem(Item& item, float dt)
-{
-  if (item.cooldown > 0.0f)
+  const float area = (max.x - min.x) * (max.y - min.y);
+  world_grid.Resize(min, max, std::max(FLOW_CELL_SIZE, std::sqrt(area / FLOW_MAX_CELLS)));
+
+  // Walls block pathing and line of sight too
+  const float step = world_grid.CellSize() * 0.5f;
+  for (const Segment& wall : segments)
   {
-    item.cooldown -= dt;
-    if (item.cooldown < 0.0f) item.cooldown = 0.0f;
+    const int steps = int(std::ceil(distance(wall.a, wall.b) / step));
+    for (int s = 0; s <= steps; s++)
+    {
+      world_grid.SetBlocked(wall.a + (wall.b - wall.a) * (float(s) / float(steps)), true);
+    }
   }
+}
+
 
-  item.animation_time += dt;
+ChunkCoord Game::ChunkAt(vec2 position) const
+{
+  return {int32_t(std::floor(position.x / scene.chunk_size)), int32_t(std::floor(position.y / scene.chunk_size))};
 }
 
 
-void Game::UpdateProjectile(Projectile& projectile, float dt)
+ChunkContents Game::GenerateChunk(const SceneConfig& config, uint32_t world_seed, ChunkCoord coord) const
 {
-  projectile.ttl -= dt;
-  projectile.position += (projectile.velocity * dt);
+  ChunkContents contents;
+  Random rng(ChunkSeed(world_seed, coord));
+
+  const float size = config.chunk_size;
+  const vec2 min{coord.x * size, coord.y * size};
+  const vec2 max{min.x + size, min.y + size};
+
+  // Kept inside the chunk, so neighbours' walls never cross
+  const float length = std::min(CHUNK_WALL_LENGTH, size * 0.5f);
+  const vec2 inset{length * 0.5f, length * 0.5f};
+  const int num_walls = rng.Int(0, CHUNK_MAX_WALLS);
+  for (int i = 0; i < num_walls; i++)
+  {
+    const vec2 centre = rng.Position(min + inset, max - inset);
+    const vec2 along = angle_to_vec2(rng.Float(0.0f, TWO_PI), length * 0.5f);
+    contents.walls.push_back({centre - along, centre + along});
+  }
+
+  SegmentBVH local_walls;
+  local_walls.Build(contents.walls);
+
+  for (int i = 0; i < config.num_items; i++)
+  {
+    Item item = item_factory.GenerateRandomItem(rng);
+    item.position = item.last_position = local_walls.PushOut(rng.Position(min, max), item.radius);
+
+    // Onto a stack it lands on, like MergeWorldItems()
+    auto stack = std::find_if(contents.items.begin(), contents.items.end(), [&](const Item& other) {
+      const float radii = item.radius + other.radius;
+      return other.StacksWith(item) and distance_squared(item.position, other.position) <= radii * radii;
+    });
+    if (stack != contents.items.end())
+    {
+      stack->Merge(item);
+    }
+    else
+    {
+      contents.items.push_back(item);
+    }
+  }
+
+  for (int i = 0; i < config.num_monsters; i++)
+  {
+    Monster monster = item_factory.GenerateRandomMonster(rng);
+    monster.position = monster.last_position = local_walls.PushOut(rng.Position(min, max), monster.radius);
+    contents.monsters.push_back(monster);
+  }
+
+  return contents;
 }
 
 
-void Game::UpdateMonster(Monster& monster, float dt)
+void Game::StreamChunks()
 {
-  if (monster.health.current <= 0) monster.alive = false;
-  monster.position += (monster.velocity * dt);
+  if (scene.chunk_size <= 0.0f) return;
+
+  std::vector<ChunkCoord>& loaded = gamestate.loaded_chunks;
+
+  // New game, or a snapshot of a different one
+  const bool reset = not generator_ready or generator_seed != gamestate.world_seed;
+  if (reset)
+  {
+    chunk_generator.Reset([this, config = scene, seed = gamestate.world_seed](ChunkCoord coord) {
+      return GenerateChunk(config, seed, coord);
+    });
+    generator_seed = gamestate.world_seed;
+    generator_ready = true;
+    chunk_walls.clear();
+    walled_chunks.clear();
+  }
+
+  const ChunkCoord centre = ChunkAt(gamestate.player.position);
+  auto within = [&](ChunkCoord coord, int radius) {
+    return std::abs(coord.x - centre.x) <= radius and std::abs(coord.y - centre.y) <= radius;
+  };
+
+  std::vector<ChunkCoord> left;
+  for (ChunkCoord coord : loaded)
+  {
+    if (not within(coord, CHUNK_KEEP_RADIUS)) left.push_back(coord);
+  }
+  if (not left.empty())
+  {
+    loaded.erase(std::remove_if(loaded.begin(), loaded.end(),
+                   [&](ChunkCoord coord) { return not within(coord, CHUNK_KEEP_RADIUS); }),
+      loaded.end());
+    SaveChunks(left);
+  }
+
+  // In order, so they're added to the world in the same order every time
+  for (int x = centre.x - CHUNK_LOAD_RADIUS; x <= centre.x + CHUNK_LOAD_RADIUS; x++)
+  {
+    for (int y = centre.y - CHUNK_LOAD_RADIUS; y <= centre.y + CHUNK_LOAD_RADIUS; y++)
+    {
+      const ChunkCoord coord{x, y};
+      auto place = std::lower_bound(loaded.begin(), loaded.end(), coord);
+      if (place != loaded.end() and *place == coord) continue;
+
+      loaded.insert(place, coord);
+      LoadChunk(coord);
+    }
+  }
+
+  if (reset or centre != prefetch_centre)
+  {
+    prefetch_centre = centre;
+    for (int x = centre.x - CHUNK_PREFETCH_RADIUS; x <= centre.x + CHUNK_PREFETCH_RADIUS; x++)
+    {
+      for (int y = centre.y - CHUNK_PREFETCH_RADIUS; y <= centre.y + CHUNK_PREFETCH_RADIUS; y++)
+      {
+        const ChunkCoord coord{x, y};
+        if (not std::binary_search(loaded.begin(), loaded.end(), coord)) chunk_generator.Request(coord);
+      }
+    }
+    chunk_generator.Retain(centre, CHUNK_PREFETCH_RADIUS);
+  }
+
+  if (walled_chunks != loaded) ResizeWorld();
 }
 
 
-template<typename ITEM>
-ITEM* GetClosest(vec2 position, ITEM* i1, ITEM& i2)
+void Game::SaveChunks(const std::vector<ChunkCoord>& left)
 {
-  if (i1 == nullptr)
+  const std::vector<ChunkCoord>& loaded = gamestate.loaded_chunks;
+  auto is_loaded = [&](ChunkCoord coord) { return std::binary_search(loaded.begin(), loaded.end(), coord); };
+
+  // Everything outside the loaded chunks, by the chunk it's in now.  The
+  // ones just left are saved even if they're empty, so they stay that way.
+  std::map<ChunkCoord, ChunkContents> leaving;
+  for (ChunkCoord coord : left)
   {
-    return &i2;
+    leaving[coord];
   }
-  else
+
+  auto& items = gamestate.world_items;
+  std::vector<SlotHandle> gone_items;
+  for (int i = 0; i < items.size(); i++)
   {
-    if (distance(position, i2.position) < distance(position, i1->position))
+    const ChunkCoord coord = ChunkAt(items[i].position);
+    if (is_loaded(coord)) continue;
+
+    leaving[coord].items.push_back(items[i]);
+    gone_items.push_back(items.HandleAt(i));
+  }
+  for (SlotHandle handle : gone_items)
+  {
+    items.Remove(handle);
+  }
+
+  // Dead ones are removed next tick anyway
+  auto& monsters = gamestate.world_monsters;
+  std::vector<SlotHandle> gone_monsters;
+  for (int i = 0; i < monsters.size(); i++)
+  {
+    const ChunkCoord coord = ChunkAt(monsters[i].position);
+    if (not monsters[i].alive or is_loaded(coord)) continue;
+
+    leaving[coord].monsters.push_back(monsters[i]);
+    gone_monsters.push_back(monsters.HandleAt(i));
+  }
+  for (SlotHandle handle : gone_monsters)
+  {
+    monsters.Remove(handle);
+  }
+
+  std::vector<SavedChunk>& saved = gamestate.saved_chunks;
+  GameState chunk_state(0);
+  for (auto& chunk : leaving)
+  {
+    const ChunkCoord coord = chunk.first;
+    bool generated = std::find(left.begin(), left.end(), coord) != left.end();
+
+    // Added to whatever was saved there before, and moved to the back
+    chunk_state.world_items.clear();
+    chunk_state.world_monsters.clear();
+    auto old = std::find_if(saved.begin(), saved.end(), [&](const SavedChunk& s) { return s.coord == coord; });
+    if (old != saved.end())
     {
-      return &i2;
+      ReadSnapshot(old->snapshot.data(), old->snapshot.size(), chunk_state);
+      generated = generated or old->generated;
+      saved.erase(old);
     }
-    else
+
+    for (const Item& item : chunk.second.items)
+    {
+      chunk_state.world_items.Insert(item);
+    }
+    for (const Monster& monster : chunk.second.monsters)
     {
-      return i1;
+      chunk_state.world_monsters.Insert(monster);
     }
+
+    saved.push_back({coord, generated, WriteSnapshot(chunk_state)});
   }
+
+  if (int(saved.size()) > CHUNK_SAVED_MAX) saved.erase(saved.begin(), saved.end() - CHUNK_SAVED_MAX);
 }
 
 
-void Game::Update(float dt)
+void Game::LoadChunk(ChunkCoord coord)
 {
-  gamestate.wallclock += dt;
+  ChunkContents contents = chunk_generator.Take(coord);
+  chunk_walls[coord] = std::move(contents.walls);
+
+  auto add_item = [&](const Item& item) {
+    const SlotHandle handle = gamestate.world_items.Insert(item);
+    if (item.awake) gamestate.awake_items.push_back(handle);
+  };
+  auto add_monster = [&](Monster monster) {
+    monster.moved_at = gamestate.wallclock;
+    gamestate.world_monsters.Insert(monster);
+  };
+
+  // What was left there, and what it started with if it was never loaded
+  bool generated = false;
+  std::vector<SavedChunk>& saved = gamestate.saved_chunks;
+  auto old = std::find_if(saved.begin(), saved.end(), [&](const SavedChunk& s) { return s.coord == coord; });
+  if (old != saved.end())
+  {
+    GameState chunk_state(0);
+    ReadSnapshot(old->snapshot.data(), old->snapshot.size(), chunk_state);
+    generated = old->generated;
+    saved.erase(old);
 
-  UpdatePlayer(dt);
+    for (auto& item : chunk_state.world_items)
+    {
+      add_item(item);
+    }
+    for (auto& monster : chunk_state.world_monsters)
+    {
+      add_monster(monster);
+    }
+  }
 
-  gamestate.closest_item = nullptr;
-  gamestate.mouseover_item = nullptr;
+  if (generated) return;
 
-  for (auto& item : gamestate.world_items)
+  for (const Item& item : contents.items)
+  {
+    add_item(item);
+  }
+  for (const Monster& monster : contents.monsters)
   {
-    UpdateItem(item, dt);
+    add_monster(monster);
+  }
+}
+
+
+void Game::SetThreadCount(int num_threads)
+{
+  thread_pool = std::make_unique<ThreadPool>(num_threads);
+}
+
+
+void Game::Seed(uint32_t game_seed, uint32_t factory_seed)
+{
+  random.Seed(game_seed);
+  item_factory.random.Seed(factory_seed);
+}
+
 
-    if (Collides(gamestate.player, item))
+void Game::UpdatePlayer(float dt)
+{
+  gamestate.player.last_position = gamestate.player.position;
+  gamestate.player.position += (gamestate.player.velocity * dt);
+  gamestate.player.position = walls.PushOut(gamestate.player.position, gamestate.player.radius);
+}
+
+
+vec2 Game::Separation(int index) const
+{
+  const vec2 position = monster_grid.Position(index);
+  const float radius = monster_grid.Radius(index);
+
+  vec2 push{0.0f, 0.0f};
+  monster_grid.QueryNeighbours(position, radius, [&](int other, vec2 other_position, float other_radius) {
+    if (other == index) return;
+
+    const vec2 away = position - other_position;
+    const float radii = radius + other_radius;
+    const float distance = get_length(away);
+
+    // Right on top of each other, so split them along x by index
+    if (distance == 0.0f)
     {
-      gamestate.closest_item = GetClosest(gamestate.player.position, gamestate.closest_item, item);
+      push.x += other < index ? 1.0f : -1.0f;
+      return;
     }
 
-    if (Collides(gamestate.mouse_position, 20.0f, item.position, item.radius))
+    // Harder the more they overlap
+    push += away * ((radii - distance) / (radii * distance));
+  });
+
+  const float length = get_length(push);
+  if (length > 1.0f) push = push * (1.0f / length);
+
+  return push * SEPARATION_SPEED;
+}
+
+
+int Game::UpdatePeriod(const Monster& monster) const
+{
+  if (not monster_lod) return 1;
+
+  const float distance2 = distance_squared(monster.position, gamestate.player.position);
+  if (distance2 < LOD_NEAR_DISTANCE * LOD_NEAR_DISTANCE) return 1;
+  if (distance2 < LOD_FAR_DISTANCE * LOD_FAR_DISTANCE) return LOD_MID_PERIOD;
+  return LOD_FAR_PERIOD;
+}
+
+
+void Game::UpdateMonster(int index, float dt)
+{
+  Monster& monster = gamestate.world_monsters[index];
+
+  vec2 velocity{0.0f, 0.0f};
+  if (monster.type == Monster_Type::melee)
+  {
+    const Player& player = gamestate.player;
+
+    // Stop once touching, rather than pushing into the player
+    if (not Collides(player, monster))
+      velocity = melee_field.Direction(world_grid, monster.position, player.position) * MELEE_SPEED;
+  }
+
+  monster.velocity = velocity + Separation(index);
+
+  monster.last_position = monster.position;
+  monster.position = walls.PushOut(monster.position + monster.velocity * dt, monster.radius);
+}
+
+
+// Keeps whichever thing offered is closest to position, the lowest index on a
+// tie, so it doesn't matter what order they're found in.  -1 is nothing.
+struct Closest
+{
+  vec2 position;
+  int index = -1;
+  float distance = 0.0f;
+
+  void Offer(int i, vec2 thing)
+  {
+    const float d = ::distance(position, thing);
+    if (index < 0 or d < distance or (d == distance and i < index))
     {
-      gamestate.mouseover_item = GetClosest(gamestate.mouse_position, gamestate.mouseover_item, item);
+      index = i;
+      distance = d;
     }
   }
+};
+
+
+void Game::UpdateShooters()
+{
+  const Player& player = gamestate.player;
+  auto& monsters = gamestate.world_monsters;
+
+  shooters.clear();
+  for (int i = 0; i < monsters.size(); i++)
+  {
+    const Monster& monster = monsters[i];
+    if (monster.type == Monster_Type::shooter and monster.alive and monster.fire_ready <= gamestate.wallclock and
+        Collides(monster.position, 0.0f, player.position, SHOOTER_RANGE))
+    {
+      shooters.push_back(i);
+    }
+  }
+
+  shooter_sight.resize(shooters.size());
+  thread_pool->ParallelFor(int(shooters.size()), SHOOTER_CHUNK_SIZE, [&](int, int begin, int end) {
+    for (int s = begin; s < end; s++)
+    {
+      shooter_sight[s] = world_grid.LineOfSight(monsters[shooters[s]].position, player.position);
+    }
+  });
+
+  // Fired in monster order, so the projectiles are always added the same way
+  for (size_t s = 0; s < shooters.size(); s++)
+  {
+    if (not shooter_sight[s]) continue;
+
+    Monster& monster = monsters[shooters[s]];
+    ShootAtPlayer(monster);
+    monster.fire_ready = gamestate.wallclock + SHOOTER_COOLDOWN;
+  }
+}
+
+
+void Game::UpdateItemTree()
+{
+  auto& items = gamestate.world_items;
+
+  // Once everything has settled, or too much has moved to keep checking it all separately
+  const bool settled = gamestate.awake_items.empty() and not moved_items.empty();
+  const bool scattered = int(moved_items.size()) > items.size() / ITEM_TREE_MOVED_FRACTION + 64;
+
+  if (items.Version() == item_tree_version and not settled and not scattered) return;
+
+  // So a copy of the state from before now never matches the new tree
+  if (settled or scattered) items.Touch();
+
+  item_tree.Clear();
+  for (auto& item : items)
+  {
+    item_tree.Add(item.position, item.radius);
+  }
+  item_tree.Build();
+  item_tree_version = items.Version();
+
+  item_place.assign(items.size(), Tree_Place::current);
+  moved_items.clear();
+}
+
+
+void Game::UpdateItems(float dt)
+{
+  auto& items = gamestate.world_items;
+  auto& awake = gamestate.awake_items;
+
+  if (awake.empty()) return;
+
+  auto mark_moved = [&](int index, Tree_Place place) {
+    if (item_place[index] != Tree_Place::current) return;
+    moved_items.push_back(index);
+    item_place[index] = place;
+  };
+
+  // In item order, so it comes out the same however they were woken.  One
+  // can be in there twice if it went to sleep and was woken again.
+  moving_items.clear();
+  for (SlotHandle handle : awake)
+  {
+    const int index = items.IndexOf(handle);
+    if (index >= 0 and items[index].awake) moving_items.push_back(index);
+  }
+  std::sort(moving_items.begin(), moving_items.end());
+  moving_items.erase(std::unique(moving_items.begin(), moving_items.end()), moving_items.end());
 
-  for (auto& projectile : gamestate.world_projectiles)
+  // Everything that has moved since the tree was built, where it is now
+  for (int i : moving_items)
+  {
+    mark_moved(i, Tree_Place::moved);
+    items[i].last_position = items[i].position;
+  }
+  moved_grid.Clear();
+  for (int i : moved_items)
   {
-    UpdateProjectile(projectile, dt);
+    item_place[i] = Tree_Place::moved;
+    moved_grid.Add(items[i].position, items[i].radius);
+  }
+  moved_grid.Build();
+
+  const float damping = std::exp(-ITEM_FRICTION * dt);
+  merged_items.clear();
 
-    for (auto& monster : gamestate.world_monsters)
+  for (int i : moving_items)
+  {
+    Item& item = items[i];
+    if (not item.awake) continue;
+
+    item.position = walls.PushOut(item.position + item.velocity * dt, item.radius);
+    item.velocity *= damping;
+
+    // Everything it might be touching, going by where they were at the start
+    // of the tick, in item order
+    item_contacts.clear();
+    item_tree.QueryOverlaps(item.position, item.radius, [&](int j) {
+      if (item_place[j] == Tree_Place::current or item_place[j] == Tree_Place::woken) item_contacts.push_back(j);
+    });
+    moved_grid.QueryOverlaps(item.position, item.radius, [&](int k) {
+      const int j = moved_items[k];
+      if (j != i and item_place[j] != Tree_Place::merged) item_contacts.push_back(j);
+    });
+    std::sort(item_contacts.begin(), item_contacts.end());
+
+    for (int j : item_contacts)
     {
-      if (Collides(projectile, monster))
+      Item& other = items[j];
+      if (not Collides(item, other)) continue;
+
+      // Landing on a matching stack joins it
+      if (other.StacksWith(item))
+      {
+        other.Merge(item);
+        item.awake = false;
+        item_place[i] = Tree_Place::merged;
+        merged_items.push_back(items.HandleAt(i));
+        break;
+      }
+
+      const vec2 offset = item.position - other.position;
+      const float d = get_length(offset);
+      const vec2 normal = d > 0.0f ? offset * (1.0f / d) : vec2{1.0f, 0.0f};
+      const float overlap = item.radius + other.radius - d;
+      const float closing = dot(item.velocity - other.velocity, normal);
+
+      // Sleeping ones only wake up for a proper knock, otherwise they're as good as walls
+      if (not other.awake and -closing < ITEM_WAKE_SPEED)
+      {
+        item.position += normal * overlap;
+        if (closing < 0.0f) item.velocity += normal * (-closing * (1.0f + ITEM_BOUNCE));
+        continue;
+      }
+
+      if (not other.awake)
       {
-        monster.health.current -= projectile.damage;
-        projectile.ttl = 0.0f;
-        std::cout << "projectile hit " << monster.name << " for " << projectile.damage << " damage." << std::endl;
+        other.awake = true;
+        other.last_position = other.position;
+        awake.push_back(items.HandleAt(j));
+        mark_moved(j, Tree_Place::woken);
       }
+
+      // Same weight, so each moves half the overlap, and they swap some speed
+      item.position += normal * (overlap * 0.5f);
+      other.position += normal * (overlap * -0.5f);
+      if (closing < 0.0f)
+      {
+        const float impulse = -closing * (1.0f + ITEM_BOUNCE) * 0.5f;
+        item.velocity += normal * impulse;
+        other.velocity += normal * -impulse;
+      }
+    }
+
+    if (item.awake and get_length(item.velocity) < ITEM_SLEEP_SPEED)
+    {
+      item.awake = false;
+      item.velocity = {0.0f, 0.0f};
+      item.last_position = item.position;
     }
   }
 
-  gamestate.mouseover_monster = nullptr;
+  remove_if_inplace(awake, [&](SlotHandle handle) {
+    const Item* item = items.Get(handle);
+    return item == nullptr or not item->awake;
+  });
+  std::sort(awake.begin(), awake.end(), [](SlotHandle a, SlotHandle b) { return a.index < b.index; });
+  awake.erase(std::unique(awake.begin(), awake.end()), awake.end());
+
+  for (SlotHandle handle : merged_items)
+  {
+    items.Remove(handle);
+  }
+}
+
+
+void Game::Update(float dt)
+{
+  gamestate.wallclock += dt;
+
+  StreamChunks();
 
+  gamestate.monster_spawns.Advance(TimerTick(gamestate.wallclock), [&](Monster& monster) {
+    monster.moved_at = gamestate.wallclock;
+    gamestate.world_monsters.Insert(monster);
+  });
+
+  UpdatePlayer(dt);
+
+  auto& items = gamestate.world_items;
+
+  // Items only move after being dropped or knocked, and otherwise just get
+  // picked up (cooldowns are timestamps)
+  UpdateItemTree();
+  UpdateItems(dt);
+  UpdateItemTree();
+
+  // From the tree, apart from the ones that have moved since it was built
+  auto find_item = [&](vec2 position, float radius) {
+    Closest closest{position};
+    item_tree.QueryOverlaps(position, radius, [&](int index) {
+      if (item_place[index] == Tree_Place::current) closest.Offer(index, item_tree.Position(index));
+    });
+    for (int index : moved_items)
+    {
+      if (Collides(position, radius, items[index].position, items[index].radius))
+        closest.Offer(index, items[index].position);
+    }
+    return items.HandleAt(closest.index);
+  };
+
+  gamestate.closest_item = find_item(gamestate.player.position, gamestate.player.radius);
+  gamestate.mouseover_item = find_item(gamestate.mouse_position, MOUSE_RADIUS);
+
+  monster_grid.Clear();
   for (auto& monster : gamestate.world_monsters)
   {
-    UpdateMonster(monster, dt);
+    monster_grid.Add(monster.position, monster.radius);
+  }
+  monster_grid.Build();
+
+  ProjectileStore& projectiles = gamestate.world_projectiles;
+
+  const int num_projectile_chunks = ThreadPool::NumChunks(projectiles.size(), UPDATE_CHUNK_SIZE);
+  if (int(chunk_hits.size()) < num_projectile_chunks) chunk_hits.resize(num_projectile_chunks);
+
+  thread_pool->ParallelFor(projectiles.size(), UPDATE_CHUNK_SIZE, [&](int chunk, int begin, int end) {
+    projectiles.Integrate(dt, begin, end);
+
+    auto& found = chunk_hits[chunk];
+    found.clear();
+
+    for (int p = begin; p < end; p++)
+    {
+      // Swept from where it was last tick, so nothing fast can skip past a target
+      const vec2 start{projectiles.last_x[p], projectiles.last_y[p]};
+      const vec2 stop = projectiles.Position(p);
+      const float radius = projectiles.radius[p];
+
+      // Stopped by a wall, unless it gets to something else first
+      const float wall = walls.SweepTime(start, stop, radius);
+      auto hit_wall_first = [&](float t) {
+        if (wall >= 0.0f and (t < 0.0f or wall < t))
+        {
+          found.push_back({p, PROJECTILE_HIT_WALL});
+          return true;
+        }
+        return false;
+      };
+
+      if (projectiles.hostile[p])
+      {
+        const Player& player = gamestate.player;
+        const float t = SweptCircleTime(start, stop, radius, player.position, player.radius);
+        if (not hit_wall_first(t) and t >= 0.0f) found.push_back({p, -1});
+        continue;
+      }
+
+      // Only what it touches first (or is already touching), however long the tick
+      const vec2 middle = (start + stop) * 0.5f;
+      const float reach = distance(start, stop) * 0.5f + radius;
+      auto time_to = [&](int index) {
+        return SweptCircleTime(start, stop, radius, monster_grid.Position(index), monster_grid.Radius(index));
+      };
+
+      float first = -1.0f;
+      monster_grid.QueryOverlaps(middle, reach, [&](int index) {
+        const float t = time_to(index);
+        if (t >= 0.0f and (first < 0.0f or t < first)) first = t;
+      });
+
+      if (hit_wall_first(first) or first < 0.0f) continue;
 
-    if (Collides(gamestate.mouse_position, 20.0f, monster.position, monster.radius))
+      monster_grid.QueryOverlaps(middle, reach, [&](int index) {
+        if (time_to(index) == first) found.push_back({p, index});
+      });
+    }
+  });
+
+  for (int chunk = 0; chunk < num_projectile_chunks; chunk++)
+  {
+    for (auto& hit : chunk_hits[chunk])
     {
-      gamestate.mouseover_monster = GetClosest(gamestate.mouse_position, gamestate.mouseover_monster, monster);
+      projectiles.Expire(hit.projectile, gamestate.wallclock);
+
+      if (hit.monster == PROJECTILE_HIT_WALL) continue;
+
+      if (hit.monster < 0)
+      {
+        Health& health = gamestate.player.health;
+        health.current = std::max(health.current - projectiles.damage[hit.projectile], 0);
+        if constexpr (DEBUG_COMBAT)
+          std::cout << "projectile hit the player for " << projectiles.damage[hit.projectile] << " damage." << std::endl;
+        continue;
+      }
+
+      Monster& monster = gamestate.world_monsters[hit.monster];
+      monster.health.current -= projectiles.damage[hit.projectile];
+      if constexpr (DEBUG_COMBAT)
+        std::cout << "projectile hit " << monster.name << " for " << projectiles.damage[hit.projectile] << " damage." << std::endl;
+
+      if (monster.alive and monster.health.current <= 0)
+      {
+        monster.alive = false;
+        gamestate.dead_monsters.push_back(gamestate.world_monsters.HandleAt(hit.monster));
+      }
     }
   }
+
+  auto& monsters = gamestate.world_monsters;
+
+  melee_field.Update(world_grid, gamestate.player.position);
+
+  // Ticks so far, going by the clock, so it comes back the same from a snapshot
+  const long tick = std::lround(gamestate.wallclock / dt);
+
+  thread_pool->ParallelFor(monsters.size(), UPDATE_CHUNK_SIZE, [&](int, int begin, int end) {
+    for (int i = begin; i < end; i++)
+    {
+      Monster& monster = monsters[i];
+
+      // Staggered by index, so each tick only does a share of them
+      if ((tick + i) % UpdatePeriod(monster) == 0)
+      {
+        monster.step_dt = gamestate.wallclock - monster.moved_at;
+        monster.moved_at = gamestate.wallclock;
+        UpdateMonster(i, monster.step_dt);
+      }
+    }
+  });
+
+  // On the ticks that cross into a new AI step
+  if (int(gamestate.wallclock * SHOOTER_AI_RATE) != int((gamestate.wallclock - dt) * SHOOTER_AI_RATE))
+  {
+    UpdateShooters();
+  }
+
+  // Where they were at the start of the tick, which is near enough for the mouse
+  Closest mouseover_monster{gamestate.mouse_position};
+  monster_grid.QueryOverlaps(gamestate.mouse_position, MOUSE_RADIUS, [&](int index) {
+    mouseover_monster.Offer(index, monster_grid.Position(index));
+  });
+  gamestate.mouseover_monster = monsters.HandleAt(mouseover_monster.index);
+}
+
+
+// One fixed length step of the simulation
+void Game::Tick(float dt)
+{
+  RemoveDeadItems();
+  Update(dt);
 }
 
 
@@ -138,20 +910,20 @@ void Game::ProcessKeyInput(int key, bool down)
     std::cout << "Input key: '" << GetInputName(key) << "'  "
               << (down ? "(Pressed)" : "(Released)") << std::endl;
 
-  if (key == SDLK_LSHIFT) debug.flag1 = down;
-  if (key == SDLK_RSHIFT) debug.flag2 = down;
+  if (key == SDL_SCANCODE_LSHIFT) debug.flag1 = down;
+  if (key == SDL_SCANCODE_RSHIFT) debug.flag2 = down;
 
   if (not gamestate.drop_mode)
   {
-    auto it = gamestate.player.KeyBindInventory.find(key);
-    if (it == gamestate.player.KeyBindInventory.end())
+    Item* bound_item = gamestate.player.KeyBindInventory.Find(key);
+    if (bound_item == nullptr)
     {
-      if (gamestate.closest_item != nullptr)
+      Item* closest = gamestate.world_items.Get(gamestate.closest_item);
+      if (closest != nullptr)
       {
-        if (down)
+        if (down and PickupItem(key, *closest))
         {
-          PickupItem(key, *gamestate.closest_item);
-          gamestate.closest_item = gamestate.mouseover_item = nullptr;
+          gamestate.world_items.Remove(gamestate.closest_item);
         }
       }
       else
@@ -161,25 +933,24 @@ void Game::ProcessKeyInput(int key, bool down)
     }
     else
     {
-      Item& item = it->second;
-
-      ActivateItem(item, down);
+      ActivateItem(*bound_item, down);
     }
   }
   else //Drop mode
   {
     DropItem(key, down);
-    gamestate.closest_item = gamestate.mouseover_item = nullptr;
   }
 }
 
 
 void Game::ProcessMouseInput(int button, bool down)
 {
+  const int input = MouseButtonInput(button);
+
   if constexpr (DEBUG_INPUT and down)
-    std::cout << "Input mouse button: '" << GetInputName(button) << "'" << std::endl;
+    std::cout << "Input mouse button: '" << GetInputName(input) << "'" << std::endl;
 
-  ProcessKeyInput(button, down);
+  ProcessKeyInput(input, down);
 }
 
 
@@ -194,31 +965,47 @@ void Game::ProcessMouseMotion(int x, int y)
 }
 
 
-void Game::PickupItem(int key, Item& item)
+bool Game::PickupItem(int key, Item& item)
 {
-  std::cout << "Picked up item '" << item.name << "'  - Bound to key  " << GetInputName(key) << std::endl;
-  assert(not key_exists(gamestate.player.KeyBindInventory, key));
+  // Onto a stack already in the inventory, leaving the key free
+  for (auto& binding : gamestate.player.KeyBindInventory)
+  {
+    if (binding.item.StacksWith(item))
+    {
+      binding.item.Merge(item);
+      std::cout << "Picked up item '" << item.name << "'  - Added to stack on key  " << GetInputName(binding.key)
+                << " (" << binding.item.count << ")" << std::endl;
+      return true;
+    }
+  }
+
+  assert(not gamestate.player.KeyBindInventory.Contains(key));
+  if (not gamestate.player.KeyBindInventory.Bind(key, item))
+  {
+    std::cout << "Cannot bind item '" << item.name << "' to  " << GetInputName(key) << std::endl;
+    return false;
+  }
 
-  gamestate.player.KeyBindInventory.insert({key, item});
-  item.alive = false;
+  std::cout << "Picked up item '" << item.name << "'  - Bound to key  " << GetInputName(key) << std::endl;
+  return true;
 }
 
 
 void Game::DropItem(int key, bool down)
 {
-  auto it = gamestate.player.KeyBindInventory.find(key);
-  if (it == gamestate.player.KeyBindInventory.end())
+  const Item* bound_item = gamestate.player.KeyBindInventory.Find(key);
+  if (bound_item == nullptr)
   {
     std::cout << "Noting in that inventory slot to drop  " << GetInputName(key) << std::endl;
     gamestate.drop_mode = false;
   }
   else
   {
-    Item i = it->second;
+    Item i = *bound_item;
 
     if (i.type == Item_Type::command)
     {
-      if (i.name == "DROP" and not down)
+      if (i.command == Command_Type::drop and not down)
       {
         gamestate.drop_mode = false;
       }
@@ -231,12 +1018,27 @@ void Game::DropItem(int key, bool down)
 
     std::cout << "Dropping item " << i.name << std::endl;
 
-    i.position = gamestate.player.position + vec2{RandomFloat(-20, 20), RandomFloat(-20, 20)};
+    // Stacks drop one at a time
+    if (i.count > 1)
+    {
+      i = gamestate.player.KeyBindInventory.Find(key)->SplitOne();
+    }
+    else
+    {
+      gamestate.player.KeyBindInventory.Unbind(key);
+    }
+
+    // Thrown so it slides to a stop at the mouse, or as far as it goes.  The
+    // player may have walked since the mouse last moved, so not player.direction.
+    vec2 player_to_mouse = gamestate.mouse_position - gamestate.player.position;
+    const float range = std::min(get_length(player_to_mouse), ITEM_THROW_RANGE);
+    if (player_to_mouse.x == 0.0f and player_to_mouse.y == 0.0f) player_to_mouse.x = 1.0f;
 
-    gamestate.world_items.push_back(i);
-    gamestate.closest_item = gamestate.mouseover_item = nullptr;
+    i.position = i.last_position = gamestate.player.position;
+    i.velocity = normalize(player_to_mouse) * (range * ITEM_FRICTION);
+    i.awake = true;
+    AddWorldItem(i);
 
-    gamestate.player.KeyBindInventory.erase(it);
     gamestate.drop_mode = false;
   }
 }
@@ -245,17 +1047,35 @@ void Game::ActivateCommand(Item& item, bool down)
 {
   float player_speed = down ? 400 : 0;
 
-  if (item.name == "UP") gamestate.player.velocity.y = -player_speed;
-  if (item.name == "DOWN") gamestate.player.velocity.y = player_speed;
-  if (item.name == "LEFT") gamestate.player.velocity.x = -player_speed;
-  if (item.name == "RIGHT") gamestate.player.velocity.x = player_speed;
+  switch (item.command)
+  {
+    case Command_Type::up:
+      gamestate.player.velocity.y = -player_speed;
+      break;
 
-  if (item.name == "MENU" and down) gamestate.running = false;
+    case Command_Type::down:
+      gamestate.player.velocity.y = player_speed;
+      break;
 
-  if (item.name == "DROP")
-  {
-    gamestate.drop_mode = down;
-    std::cout << (gamestate.drop_mode ? "DROP MODE" : "Pickup Mode") << std::endl;
+    case Command_Type::left:
+      gamestate.player.velocity.x = -player_speed;
+      break;
+
+    case Command_Type::right:
+      gamestate.player.velocity.x = player_speed;
+      break;
+
+    case Command_Type::menu:
+      if (down) gamestate.running = false;
+      break;
+
+    case Command_Type::drop:
+      gamestate.drop_mode = down;
+      std::cout << (gamestate.drop_mode ? "DROP MODE" : "Pickup Mode") << std::endl;
+      break;
+
+    case Command_Type::none:
+      break;
   }
 }
 
@@ -264,13 +1084,13 @@ void Game::ActivateItem(Item& item, bool down)
 {
   if (item.type == Item_Type::command) return ActivateCommand(item, down);
 
-  if (item.CanActivate())
+  if (item.CanActivate(gamestate.wallclock))
   {
     if (down)
     {
       std::cout << "Activate item  '" << item.name << "'  !!!  " << std::endl;
 
-      item.UseActivation();
+      item.UseActivation(gamestate.wallclock);
 
       if (item.type == Item_Type::health)
       {
@@ -289,14 +1109,13 @@ void Game::ActivateItem(Item& item, bool down)
 
 void Game::RemoveDeadItems()
 {
-  gamestate.closest_item = gamestate.mouseover_item = nullptr;
-  gamestate.mouseover_monster = nullptr;
-
-  remove_if_inplace(gamestate.world_items, [](auto& i) { return not i.alive; });
-
-  remove_if_inplace(gamestate.world_projectiles, [](auto& p) { return p.ttl <= 0.0f; });
+  for (SlotHandle handle : gamestate.dead_monsters)
+  {
+    gamestate.world_monsters.Remove(handle);
+  }
+  gamestate.dead_monsters.clear();
 
-  remove_if_inplace(gamestate.world_monsters, [](auto& m) { return not m.alive; });
+  gamestate.world_projectiles.RemoveExpired(gamestate.wallclock);
 }
 
 
@@ -304,13 +1123,98 @@ void Game::ShootProjectile(vec2 position, vec2 direction, Item& item)
 {
   Projectile p;
   p.position = position;
+  p.last_position = position;
   p.velocity = normalize(direction) * 800.0f;
   p.radius = 20.0f;
   p.damage = item.projectile_damage;
 
-  p.ttl = 2.0f;
+  p.expire_time = gamestate.wallclock + PROJECTILE_LIFETIME;
 
-  gamestate.world_projectiles.push_back(p);
+  gamestate.world_projectiles.Add(p);
+}
+
+
+void Game::ShootAtPlayer(Monster& monster)
+{
+  // Separation can push it right on top of the player
+  vec2 monster_to_player = gamestate.player.position - monster.position;
+  if (monster_to_player.x == 0.0f and monster_to_player.y == 0.0f) monster_to_player.x = 1.0f;
+
+  const vec2 direction = normalize(monster_to_player);
+
+  Projectile p;
+  p.position = monster.position + direction * monster.radius;
+  p.last_position = p.position;
+  p.velocity = direction * SHOOTER_PROJECTILE_SPEED;
+  p.radius = 8.0f;
+  p.damage = 1;
+  p.hostile = true;
+
+  p.expire_time = gamestate.wallclock + PROJECTILE_LIFETIME;
+
+  gamestate.world_projectiles.Add(p);
+}
+
+
+void Game::SpawnMonster(float delay, const Monster& monster)
+{
+  gamestate.monster_spawns.Schedule(TimerTick(gamestate.wallclock + delay), monster);
+}
+
+
+void Game::AddWorldItem(const Item& item)
+{
+  // Moving ones join a stack when they run into it, in UpdateItems()
+  if (item.awake)
+  {
+    gamestate.awake_items.push_back(gamestate.world_items.Insert(item));
+    return;
+  }
+
+  for (auto& other : gamestate.world_items)
+  {
+    if (Collides(item, other) and other.StacksWith(item))
+    {
+      other.Merge(item);
+      return;
+    }
+  }
+
+  gamestate.world_items.Insert(item);
+}
+
+
+void Game::MergeWorldItems()
+{
+  auto& items = gamestate.world_items;
+
+  SpatialGrid grid;
+  for (auto& item : items)
+  {
+    grid.Add(item.position, item.radius);
+  }
+  grid.Build();
+
+  // Each one goes onto the first stack it touches, in item order
+  std::vector<uint8_t> merged(items.size(), 0);
+  std::vector<SlotHandle> remove;
+  for (int i = 0; i < items.size(); i++)
+  {
+    if (merged[i]) continue;
+
+    grid.QueryOverlaps(items[i].position, items[i].radius, [&](int j) {
+      if (j <= i or merged[j] or not items[i].StacksWith(items[j])) return;
+
+      items[i].Merge(items[j]);
+      merged[j] = 1;
+      remove.push_back(items.HandleAt(j));
+    });
+  }
+
+  for (SlotHandle handle : remove)
+  {
+    items.Remove(handle);
+  }
 }
 
 
@@ -318,7 +1222,7 @@ Item Game::GenerateRandomItem(vec2 position)
 {
   Item i = item_factory.GenerateRandomItem();
 
-  i.position = position;
+  i.position = i.last_position = position;
 
   return i;
 }
@@ -329,6 +1233,7 @@ Monster Game::GenerateRandomMonster(vec2 position)
   Monster m = item_factory.GenerateRandomMonster();
 
   m.position = position;
+  m.last_position = position;
 
   return m;
 }
@@ -344,15 +1249,15 @@ void Game::NewPlayer()
   auto left = item_factory.GetCommand("LEFT");
   auto right = item_factory.GetCommand("RIGHT");
 
-  PickupItem(SDLK_w, up);
-  PickupItem(SDLK_s, down);
-  PickupItem(SDLK_a, left);
-  PickupItem(SDLK_d, right);
+  PickupItem(SDL_SCANCODE_W, up);
+  PickupItem(SDL_SCANCODE_S, down);
+  PickupItem(SDL_SCANCODE_A, left);
+  PickupItem(SDL_SCANCODE_D, right);
 
   auto menu = item_factory.GetCommand("MENU");
   auto drop = item_factory.GetCommand("DROP");
-  PickupItem(SDLK_ESCAPE, menu);
-  PickupItem(SDLK_BACKSPACE, drop);
+  PickupItem(SDL_SCANCODE_ESCAPE, menu);
+  PickupItem(SDL_SCANCODE_BACKSPACE, drop);
 }
 
 
@@ -364,39 +1269,72 @@ void Game::NewGame()
   gamestate.world_items.clear();
   gamestate.world_projectiles.clear();
   gamestate.world_monsters.clear();
+  gamestate.monster_spawns.clear();
+  gamestate.dead_monsters.clear();
+  gamestate.awake_items.clear();
+  gamestate.loaded_chunks.clear();
+  gamestate.saved_chunks.clear();
 
-  gamestate.closest_item = gamestate.mouseover_item = nullptr;
-  gamestate.mouseover_monster = nullptr;
+  gamestate.closest_item = gamestate.mouseover_item = {};
+  gamestate.mouseover_monster = {};
 
   NewPlayer();
 
-  constexpr int num_items = 15;
-  constexpr int num_monsters = 10;
-
-  const vec2 min_pos = {100.0f, 0.0f};
-  const vec2 max_pos = {1200.0f, 500.0f};
+  generator_ready = false;
+  chunk_walls.clear();
+  walled_chunks.clear();
 
-  for (int i = 0; i < num_items; i++)
+  if (scene.chunk_size > 0.0f)
   {
-    Item item = GenerateRandomItem(random.Position(min_pos, max_pos));
+    // The chunks around the player straight away, the rest as they get near
+    gamestate.world_seed = uint32_t(random.Int(0, INT32_MAX));
+    StreamChunks();
+  }
+  else
+  {
+    gamestate.world_seed = 0;
+    ResizeWorld();
+
+    for (int i = 0; i < scene.num_items; i++)
+    {
+      Item item = GenerateRandomItem(random.Position(scene.world_min, scene.world_max));
+
+      gamestate.world_items.Insert(item);
+    }
+    MergeWorldItems();
 
-    gamestate.world_items.push_back(item);
+    for (int i = 0; i < scene.num_monsters; i++)
+    {
+      Monster monster = GenerateRandomMonster(random.Position(scene.world_min, scene.world_max));
+
+      SpawnMonster(MONSTER_ARRIVAL_TIME * i / scene.num_monsters, monster);
+    }
   }
 
-  for (int i = 0; i < num_monsters; i++)
+  ProjectileStore& projectiles = gamestate.world_projectiles;
+  if (scene.num_projectiles > projectiles.Capacity())
   {
-    Monster monster = GenerateRandomMonster(random.Position(min_pos, max_pos));
+    projectiles.SetCapacity(scene.num_projectiles, projectiles.Overflow());
+  }
 
-    gamestate.world_monsters.push_back(monster);
+  for (int i = 0; i < scene.num_projectiles; i++)
+  {
+    Projectile p;
+    p.position = p.last_position = random.Position(scene.world_min, scene.world_max);
+    p.velocity = angle_to_vec2(random.Float(0.0f, TWO_PI), 800.0f);
+    p.radius = 20.0f;
+    p.damage = 1;
+    p.expire_time = random.Float(0.0f, SCENE_PROJECTILE_LIFETIME);
+
+    projectiles.Add(p);
   }
 }
 
 
 bool Game::Collides(const vec2& p1, float r1, const vec2& p2, float r2)
 {
-  float dist = distance(p1, p2);
   float radii = r1 + r2;
-  return dist <= radii;
+  return distance_squared(p1, p2) <= radii * radii;
 }
 
 
@@ -1,26 +1,100 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <random>
 #include <vector>
 
+#include "chunk_generator.hpp"
+#include "collision.hpp"
 #include "factories.hpp"
+#include "flow_field.hpp"
 #include "game_types.hpp"
 #include "items.hpp"
+#include "kd_tree.hpp"
 #include "maths_types.hpp"
-#include "sound.hpp"
+#include "segment_bvh.hpp"
+#include "spatial_grid.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 
 class Game
 {
 public:
+  SceneConfig scene;
+
   GameState gamestate;
-  Sound sound;
   ItemFactory item_factory;
 
+  // Streamed worlds only (see SceneConfig::chunk_size).  Makes chunks with
+  // GenerateChunk() for the seed it was last reset with.
+  ChunkGenerator chunk_generator;
+  uint32_t generator_seed = 0;
+  bool generator_ready = false;
+  ChunkCoord prefetch_centre;
+
+  // Walls of each loaded chunk, and which chunks walls was last built from
+  std::map<ChunkCoord, std::vector<Segment>> chunk_walls;
+  std::vector<ChunkCoord> walled_chunks;
+
   Random random;
 
+  SpatialGrid monster_grid;
+
+  // World items, rebuilt when one is added or removed, or once moving ones
+  // have settled.  Until then the ones that have moved are checked separately.
+  KdTree item_tree;
+  uint64_t item_tree_version = 0;
+
+  enum class Tree_Place : uint8_t
+  {
+    current,
+    moved,  // in moved_grid
+    woken,  // this tick, so not in moved_grid yet
+    merged  // into another stack this tick, about to be removed
+  };
+  std::vector<Tree_Place> item_place;
+  std::vector<int> moved_items;
+  SpatialGrid moved_grid;
+
+  // Indexes of the awake items, in order
+  std::vector<int> moving_items;
+
+  // What the item being moved might be touching, and stacks merged away this tick
+  std::vector<int> item_contacts;
+  std::vector<SlotHandle> merged_items;
+
+  // Walls, built for the scene by ResizeWorld()
+  SegmentBVH walls;
+
+  // Which bits of the world are walled off, for pathing and line of sight
+  OccupancyGrid world_grid;
+
+  // Shared by every melee monster to find its way to the player
+  FlowField melee_field;
+
+  // Update monsters far from the player less often
+  bool monster_lod = true;
+
+  // Shooters ready to fire, and whether each can see the player
+  std::vector<int> shooters;
+  std::vector<uint8_t> shooter_sight;
+
+
+  std::unique_ptr<ThreadPool> thread_pool;
+
+  // Projectile hits found by each chunk of the projectile pass.  Applied
+  // afterwards in chunk order, so the result never depends on thread timing.
+  struct ProjectileHit
+  {
+    int projectile;
+    int monster; // -1 for the player, or PROJECTILE_HIT_WALL
+  };
+  static constexpr int PROJECTILE_HIT_WALL = -2;
+
+  std::vector<std::vector<ProjectileHit>> chunk_hits;
+
   struct {
     bool flag1 = false;
     bool flag2 = false;
@@ -30,24 +104,78 @@ public:
 public:
   Game();
 
+  void SetThreadCount(int num_threads);
+
+  // Call before NewGame() to get the same game every time
+  void Seed(uint32_t game_seed, uint32_t factory_seed);
+
+  // Fills the world as described by scene
   void NewGame();
 
+  // Puts walls around the scene, or builds them from the loaded chunks in a
+  // streamed world, and fits world_grid to it
+  void ResizeWorld();
+
+  ChunkCoord ChunkAt(vec2 position) const;
+
+  // Everything a chunk starts with, from nothing but the seed and where it
+  // is.  Safe to call from any thread.
+  ChunkContents GenerateChunk(const SceneConfig& config, uint32_t world_seed, ChunkCoord coord) const;
+
+  // Loads the chunks around the player, saving and removing the ones they've
+  // left behind, and asks for the ones further out to be generated.  Does
+  // nothing unless the world is streamed.
+  void StreamChunks();
+
+  // Saves and removes everything that's no longer in a loaded chunk
+  void SaveChunks(const std::vector<ChunkCoord>& left);
+
+  // Adds what's in the chunk, as it was saved or as it was generated
+  void LoadChunk(ChunkCoord coord);
+
   void NewPlayer();
 
   void UpdatePlayer(float dt);
-  void UpdateItem(Item& item, float dt);
-  void UpdateProjectile(Projectile& projectile, float dt);
-  void UpdateMonster(Monster& monster, float dt);
+  // Moves the monster on by dt, which is however long since it last moved
+  void UpdateMonster(int index, float dt);
+
+  // Every how many ticks the monster gets updated, by distance from the player
+  int UpdatePeriod(const Monster& monster) const;
+
+  // Push away from the monsters overlapping this one, as they were when
+  // monster_grid was built.  Reads nothing else, so safe to run in parallel.
+  vec2 Separation(int index) const;
+
+  // Line of sight for every shooter at once, then the ones that can see the
+  // player fire.  Only done a few times a second.
+  void UpdateShooters();
+
+  void UpdateItemTree();
+
+  // Slides the awake items along, pushing apart (and waking) any they run
+  // into, and puts them to sleep once they've slowed down.  Sleeping items
+  // cost nothing.
+  void UpdateItems(float dt);
 
   void Update(float dt);
+  void Tick(float dt);
 
   void ProcessKeyInput(int key, bool down);
   void ProcessMouseInput(int button, bool down);
   void ProcessMouseMotion(int x, int y);
 
-  void PickupItem(int key, Item& item);
+  // Onto a matching stack in the inventory if there is one, otherwise bound to
+  // key.  Returns false, leaving item where it is, if key can't be bound.
+  bool PickupItem(int key, Item& item);
   void DropItem(int key, bool down);
 
+  // Merges it into a matching stack it touches, if there is one.  Awake
+  // items are left to run into one.
+  void AddWorldItem(const Item& item);
+
+  // Merges every touching pair of matching world items
+  void MergeWorldItems();
+
   void ActivateCommand(Item& item, bool down);
 
   void ActivateItem(Item& item, bool down);
@@ -55,6 +183,10 @@ public:
   void RemoveDeadItems();
 
   void ShootProjectile(vec2 position, vec2 direction, Item& item);
+  void ShootAtPlayer(Monster& monster);
+
+  // Adds the monster to the world after delay seconds of game time
+  void SpawnMonster(float delay, const Monster& monster);
 
 
   Item GenerateRandomItem(vec2 position);
@@ -2,22 +2,15 @@
 
 #include "maths_types.hpp"
 
-#include <map>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "items.hpp"
-
-
-struct Projectile
-{
-  vec2 position{0.0f, 0.0f};
-  vec2 velocity{0.0f, 0.0f};
-  int damage;
-  float radius;
-
-  float ttl = 0.0f;
-};
+#include "keybinds.hpp"
+#include "projectiles.hpp"
+#include "timer_wheel.hpp"
+#include "utils.hpp"
 
 
 struct Health
@@ -30,6 +23,7 @@ struct Health
 struct Player
 {
   vec2 position{200.0f, 200.0f};
+  vec2 last_position{200.0f, 200.0f};
   vec2 velocity{0.0f, 0.0f};
   float radius = 30.0f;
 
@@ -37,7 +31,7 @@ struct Player
 
   Health health{100, 100};
 
-  std::map<int, Item> KeyBindInventory;
+  KeyBindTable KeyBindInventory;
 };
 
 
@@ -57,17 +51,76 @@ struct Monster
   Monster_Type type = Monster_Type::none;
 
   vec2 position{0.0f, 0.0f};
+  vec2 last_position{0.0f, 0.0f};
   vec2 velocity{0.0f, 0.0f};
   float radius = 5.0f;
 
   Health health{0, 0};
 
+  // Game time a shooter can next fire at
+  float fire_ready = 0.0f;
+
+  // Game time it last moved at, and how long that move covered.
+  // Far away monsters move less often, see Game::UpdatePeriod().
+  float moved_at = 0.0f;
+  float step_dt = 0.0f;
+
   std::string name = "Uninitialized monster!";
 };
 
 
+// What Game::NewGame() fills the world with
+struct SceneConfig
+{
+  int num_items = 15;
+  int num_monsters = 10;
+  int num_projectiles = 0;
+
+  vec2 world_min{100.0f, 0.0f};
+  vec2 world_max{1200.0f, 500.0f};
+
+  // Over 0 for an endless world, streamed in squares this big as the player
+  // moves.  Then num_items and num_monsters are per chunk, instead of in the
+  // world box.
+  float chunk_size = 0.0f;
+};
+
+
+// Which square of a streamed world, counted in chunks from the origin
+struct ChunkCoord
+{
+  int32_t x = 0;
+  int32_t y = 0;
+
+  bool operator==(const ChunkCoord &other) const { return x == other.x and y == other.y; }
+  bool operator!=(const ChunkCoord &other) const { return not(*this == other); }
+  bool operator<(const ChunkCoord &other) const { return x < other.x or (x == other.x and y < other.y); }
+};
+
+
+// A chunk the player left, with what was in it then, as a snapshot (see
+// snapshot.hpp) of a GameState holding nothing else
+struct SavedChunk
+{
+  ChunkCoord coord;
+
+  // False if it was never loaded, and only holds things that wandered in
+  bool generated = false;
+
+  std::vector<char> snapshot;
+};
+
+
 struct GameState
 {
+  GameState() = default;
+
+  // Chunks are saved through states like this, with no room for projectiles
+  explicit GameState(int projectile_capacity)
+  : world_projectiles(projectile_capacity)
+  {
+  }
+
   bool running = false;
   bool debug_enabled = true;
 
@@ -79,11 +132,29 @@ struct GameState
 
   Player player{};
 
-  std::vector<Item> world_items;
-  std::vector<Projectile> world_projectiles;
-  std::vector<Monster> world_monsters;
+  SlotMap<Item> world_items;
+  ProjectileStore world_projectiles;
+  SlotMap<Monster> world_monsters;
+
+  // Monsters waiting to appear, by wheel tick of the game time
+  TimerWheel<Monster> monster_spawns;
+
+  // Killed this tick, removed at the start of the next one
+  std::vector<SlotHandle> dead_monsters;
+
+  // World items that are moving, the rest are asleep.  Some may be gone.
+  std::vector<SlotHandle> awake_items;
+
+  SlotHandle closest_item;
+  SlotHandle mouseover_item;
+  SlotHandle mouseover_monster;
+
+  // Streamed worlds only.  Each chunk is generated from this and where it is.
+  uint32_t world_seed = 0;
+
+  // Chunks with their contents in the world, in order
+  std::vector<ChunkCoord> loaded_chunks;
 
-  Item* closest_item = nullptr;
-  Item* mouseover_item = nullptr;
-  Monster* mouseover_monster = nullptr;
+  // Oldest first.  Ones dropped off the front are generated afresh next time.
+  std::vector<SavedChunk> saved_chunks;
 };
@@ -9,13 +9,62 @@
 #include <array>
 
 #include "maths_types.hpp"
-#include "to_string.hpp"
 
 static_assert(sizeof(GLfloat) == sizeof(float), "opengl float wrong size");
 static_assert(sizeof(GLint) == sizeof(int), "opengl int wrong size");
 static_assert(sizeof(GLenum) == sizeof(int), "opengl enum wrong size");
 
 
+std::string GLenum_ToString(GLenum e)
+{
+  switch (e)
+  {
+
+    case GL_DEBUG_SEVERITY_HIGH:
+      return "SEVERITY_HIGH";
+    case GL_DEBUG_SEVERITY_MEDIUM:
+      return "SEVERITY_MEDIUM";
+    case GL_DEBUG_SEVERITY_LOW:
+      return "SEVERITY_LOW";
+    case GL_DEBUG_SEVERITY_NOTIFICATION:
+      return "NOTIFICATION";
+    case GL_DEBUG_TYPE_ERROR:
+      return "ERROR";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+      return "DEPRECATED_BEHAVIOR";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+      return "UNDEFINED_BEHAVIOR";
+    case GL_DEBUG_TYPE_PORTABILITY:
+      return "PORTABILITY";
+    case GL_DEBUG_TYPE_PERFORMANCE:
+      return "PERFORMANCE";
+    case GL_DEBUG_TYPE_MARKER:
+      return "MARKER";
+    case GL_DEBUG_TYPE_PUSH_GROUP:
+      return "PUSH_GROUP";
+    case GL_DEBUG_TYPE_POP_GROUP:
+      return "POP_GROUP";
+    case GL_DEBUG_TYPE_OTHER:
+      return "OTHER";
+    case GL_DEBUG_SOURCE_API:
+      return "SOURCE_API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+      return "SOURCE_WINDOW_SYSTEM";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER:
+      return "SHADER_COMPILER";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:
+      return "SOURCE_THIRD_PARTY";
+    case GL_DEBUG_SOURCE_APPLICATION:
+      return "SOURCE_APPLICATION";
+    case GL_DEBUG_SOURCE_OTHER:
+      return "SOURCE_OTHER";
+
+    default:
+      return "[ERROR: Unknown GLenum]";
+  }
+}
+
+
 namespace GL {
 
 
@@ -6,6 +6,8 @@
 
 // #include "maths_types.hpp"
 
+std::string GLenum_ToString(GLenum e);
+
 namespace GL {
 
 void Debuging(bool enable);
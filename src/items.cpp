@@ -1,23 +1,33 @@
 
 #include "items.hpp"
 
+#include <algorithm>
+#include <cassert>
+
 
 void Item::AddCooldown(float c)
 {
   has_cooldown = true;
-  cooldown = 0.0f;
+  cooldown_ready = 0.0f;
   cooldown_max = c;
 }
 
 
+float Item::CooldownLeft(float now) const
+{
+  return std::max(cooldown_ready - now, 0.0f);
+}
+
+
 void Item::AddLimitedUses(int n)
 {
   has_limited_uses = true;
   uses_left = n;
+  uses_max = n;
 }
 
 
-void Item::CreateCommand(std::string cmd)
+void Item::CreateCommand(Command_Type cmd)
 {
   type = Item_Type::command;
   command = cmd;
@@ -38,11 +48,11 @@ void Item::CreateGun(int damage)
 }
 
 
-bool Item::CanActivate() const
+bool Item::CanActivate(float now) const
 {
   if (has_cooldown)
   {
-    if (cooldown > 0.0f) return false;
+    if (now < cooldown_ready) return false;
   }
 
   if (has_limited_uses)
@@ -54,15 +64,65 @@ bool Item::CanActivate() const
 }
 
 
-void Item::UseActivation()
+void Item::UseActivation(float now)
 {
   if (has_cooldown)
   {
-    cooldown = cooldown_max;
+    cooldown_ready = now + cooldown_max;
   }
 
   if (has_limited_uses)
   {
     uses_left--;
+
+    // On to the next one in the stack
+    if (uses_left <= 0 and count > 1)
+    {
+      count--;
+      uses_left = uses_max;
+    }
   }
 }
+
+
+bool Item::StacksWith(const Item &other) const
+{
+  if (type == Item_Type::command or type == Item_Type::none) return false;
+  if (has_limited_uses and (uses_left <= 0 or other.uses_left <= 0)) return false;
+
+  return type == other.type and projectile_damage == other.projectile_damage and
+         healing_amount == other.healing_amount and has_cooldown == other.has_cooldown and
+         cooldown_max == other.cooldown_max and has_limited_uses == other.has_limited_uses and
+         uses_max == other.uses_max and name == other.name and animation == other.animation;
+}
+
+
+void Item::Merge(const Item &other)
+{
+  assert(StacksWith(other));
+
+  const int total_uses = (uses_left + (count - 1) * uses_max) + (other.uses_left + (other.count - 1) * uses_max);
+
+  count += other.count;
+  cooldown_ready = std::max(cooldown_ready, other.cooldown_ready);
+
+  // Partly used ones are put together, so only the one in use is partly used
+  if (has_limited_uses)
+  {
+    count = (total_uses + uses_max - 1) / uses_max;
+    uses_left = total_uses - (count - 1) * uses_max;
+  }
+}
+
+
+Item Item::SplitOne()
+{
+  assert(count > 1);
+
+  Item one = *this;
+  one.count = 1;
+  one.uses_left = uses_max;
+
+  count--;
+  return one;
+}
@@ -15,36 +15,70 @@ enum class Item_Type
 };
 
 
-struct Item
+enum class Command_Type
 {
-  bool alive = true;
+  none,
+  up,
+  down,
+  left,
+  right,
+  menu,
+  drop
+};
 
+
+struct Item
+{
   Item_Type type = Item_Type::none;
 
   vec2 position{0.0f, 0.0f};
+  vec2 last_position{0.0f, 0.0f}; // Same as position unless it's moving
   float radius = 5.0f;
   col4 colour{0.5f, 0.5f, 0.5f, 1.0f};
 
   bool colliding = false;
 
+  // Dropped or knocked items slide until they slow down, then go to sleep
+  vec2 velocity{0.0f, 0.0f};
+  bool awake = false;
+
+  // Identical items are kept as one stack, see StacksWith().  Activating a
+  // stack uses one of them, the rest are spares.
+  int count = 1;
+
+  // Cooldowns are stored as the game time the item is ready again, so
+  // nothing needs counting down every tick
   void AddCooldown(float c);
   bool has_cooldown = false;
-  float cooldown = 0.0f;
+  float cooldown_ready = 0.0f;
   float cooldown_max = 0.0f;
+  float CooldownLeft(float now) const;
 
+  // Each item in a stack has uses_max, uses_left is for the one in use
   void AddLimitedUses(int n);
   bool has_limited_uses = false;
   int uses_left = 0;
+  int uses_max = 0;
+
+  bool CanActivate(float now) const;
+  void UseActivation(float now);
+
+  // Same kind of item, with uses left if it has limited uses.  Colour,
+  // position, animation offset and cooldown don't count, the stack keeps its own.
+  bool StacksWith(const Item &other) const;
+
+  // Adds other's items and uses to this stack
+  void Merge(const Item &other);
 
-  bool CanActivate() const;
-  void UseActivation();
+  // Takes an unused item off a stack of more than one
+  Item SplitOne();
 
 
   //todo passive, toggle, push to activate
 
-  void CreateCommand(std::string c);
+  void CreateCommand(Command_Type c);
   //bool is_command;
-  std::string command;
+  Command_Type command = Command_Type::none;
 
   void CreateHealing(int amount);
   //bool is_healing = false;
@@ -59,5 +93,5 @@ struct Item
 
 
   std::string animation;
-  float animation_time = 0.0f;
+  float animation_offset = 0.0f; // Added to the game time
 };
@@ -0,0 +1,135 @@
+#include "kd_tree.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+
+void KdTree::Clear()
+{
+  circles.clear();
+  nodes.clear();
+  node_index.clear();
+  node_axis.clear();
+  max_radius = 0.0f;
+}
+
+
+void KdTree::Add(vec2 position, float radius)
+{
+  circles.Add(position, radius);
+  max_radius = std::max(max_radius, radius);
+}
+
+
+void KdTree::Build()
+{
+  const int count = circles.size();
+
+  node_index.resize(count);
+  std::iota(node_index.begin(), node_index.end(), 0);
+  node_axis.assign(count, 0);
+
+  Build(0, count);
+
+  nodes.resize(count);
+  for (int node = 0; node < count; node++)
+  {
+    const int i = node_index[node];
+    nodes.Set(node, Position(i), circles.radius[i]);
+  }
+}
+
+
+// Splits [begin, end) at the middle, across whichever way it's spread out more
+void KdTree::Build(int begin, int end)
+{
+  if (end - begin < 2) return;
+
+  float min_x = circles.x[node_index[begin]], max_x = min_x;
+  float min_y = circles.y[node_index[begin]], max_y = min_y;
+  for (int n = begin + 1; n < end; n++)
+  {
+    const int i = node_index[n];
+    min_x = std::min(min_x, circles.x[i]);
+    max_x = std::max(max_x, circles.x[i]);
+    min_y = std::min(min_y, circles.y[i]);
+    max_y = std::max(max_y, circles.y[i]);
+  }
+
+  const int node = (begin + end) / 2;
+  const uint8_t axis = (max_y - min_y) > (max_x - min_x);
+  const std::vector<float> &key = axis ? circles.y : circles.x;
+
+  std::nth_element(node_index.begin() + begin, node_index.begin() + node, node_index.begin() + end,
+    [&](int a, int b) { return key[a] < key[b]; });
+  node_axis[node] = axis;
+
+  Build(begin, node);
+  Build(node + 1, end);
+}
+
+
+void KdTree::Nearest(vec2 position, int k, float max_distance, std::vector<int> &found) const
+{
+  found.clear();
+  if (nodes.size() == 0 or k <= 0) return;
+
+  // Best so far, sorted nearest first
+  struct Candidate
+  {
+    float distance2;
+    int index;
+
+    bool operator<(const Candidate &other) const
+    {
+      return distance2 < other.distance2 or (distance2 == other.distance2 and index < other.index);
+    }
+  };
+  std::vector<Candidate> best;
+  best.reserve(k + 1);
+
+  auto bound = [&] { return int(best.size()) < k ? max_distance * max_distance : best.back().distance2; };
+
+  // Ranges still to look at, with how far away their side of the split is
+  struct Pending
+  {
+    Range range;
+    float distance2;
+  };
+  Pending stack[64];
+  int top = 0;
+  stack[top++] = {{0, nodes.size()}, 0.0f};
+
+  while (top > 0)
+  {
+    const Pending pending = stack[--top];
+    if (pending.distance2 > bound()) continue;
+
+    const Range range = pending.range;
+    const int node = (range.begin + range.end) / 2;
+
+    const float dx = nodes.x[node] - position.x;
+    const float dy = nodes.y[node] - position.y;
+    const Candidate candidate{dx * dx + dy * dy, node_index[node]};
+    if (candidate.distance2 <= bound())
+    {
+      best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+      if (int(best.size()) > k) best.pop_back();
+    }
+
+    // Far side first on the stack, so the near side is looked at first
+    const float offset = (node_axis[node] ? position.y : position.x) - Split(node);
+    const Range low{range.begin, node};
+    const Range high{node + 1, range.end};
+    const Range near = offset < 0.0f ? low : high;
+    const Range far = offset < 0.0f ? high : low;
+
+    if (far.begin < far.end) stack[top++] = {far, offset * offset};
+    if (near.begin < near.end) stack[top++] = {near, 0.0f};
+  }
+
+  for (const Candidate &candidate : best)
+  {
+    found.push_back(candidate.index);
+  }
+}
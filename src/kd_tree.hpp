@@ -0,0 +1,89 @@
+#pragma once
+
+// 2d tree over a set of circles, for things that stay put, like items lying
+// in the world.  Building sorts everything (n log n) so it's only worth
+// redoing when the set changes, but then radius and nearest queries only
+// visit O(log n) nodes plus whatever they find.
+//
+// Stored implicitly: the node for [begin, end) is the circle at the middle,
+// with everything before it on the low side of its split and everything
+// after on the high side.
+
+#include <cstdint>
+#include <vector>
+
+#include "collision.hpp"
+#include "maths_types.hpp"
+
+
+class KdTree
+{
+private:
+  // Circles as they were added
+  CircleList circles;
+
+  // In tree order, with the index each came from
+  CircleList nodes;
+  std::vector<int> node_index;
+
+  // 0 splits on x, 1 on y
+  std::vector<uint8_t> node_axis;
+
+  float max_radius = 0.0f;
+
+  void Build(int begin, int end);
+
+  float Split(int node) const { return node_axis[node] ? nodes.y[node] : nodes.x[node]; }
+
+  struct Range
+  {
+    int begin;
+    int end;
+  };
+
+public:
+  void Clear();
+  void Add(vec2 position, float radius);
+  void Build();
+
+  int Size() const { return circles.size(); }
+
+  vec2 Position(int index) const { return {circles.x[index], circles.y[index]}; }
+  float Radius(int index) const { return circles.radius[index]; }
+
+  // Calls func(index) for every circle that overlaps the query circle, in no
+  // particular order.  Same test as OverlapBatch, so they always agree.
+  template<typename FUNC>
+  void QueryOverlaps(vec2 position, float radius, FUNC &&func) const
+  {
+    if (nodes.size() == 0) return;
+
+    const float reach = radius + max_radius;
+
+    // Deep enough for 2^64 circles
+    Range stack[64];
+    int top = 0;
+    stack[top++] = {0, nodes.size()};
+
+    while (top > 0)
+    {
+      const Range range = stack[--top];
+      const int node = (range.begin + range.end) / 2;
+
+      const float dx = nodes.x[node] - position.x;
+      const float dy = nodes.y[node] - position.y;
+      const float radii = nodes.radius[node] + radius;
+      if (dx * dx + dy * dy <= radii * radii) func(node_index[node]);
+
+      // Equal to the split can be on either side
+      const float split = Split(node);
+      const float centre = node_axis[node] ? position.y : position.x;
+      if (centre - reach <= split and range.begin < node) stack[top++] = {range.begin, node};
+      if (centre + reach >= split and node + 1 < range.end) stack[top++] = {node + 1, range.end};
+    }
+  }
+
+  // Fills found with up to k indexes, nearest centre first (lowest index
+  // first on a tie), leaving out anything further than max_distance.
+  void Nearest(vec2 position, int k, float max_distance, std::vector<int> &found) const;
+};
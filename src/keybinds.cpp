@@ -0,0 +1,60 @@
+#include "keybinds.hpp"
+
+#include <algorithm>
+
+#include <SDL.h>
+
+static_assert(NUM_SCANCODES == SDL_NUM_SCANCODES, "scancode table is the wrong size");
+static_assert(NUM_MOUSE_BUTTONS > SDL_BUTTON_X2, "mouse button table is too small");
+
+
+KeyBindTable::KeyBindTable()
+{
+  clear();
+}
+
+
+// Binding and unbinding shuffle the packed array, but only happen on pickup
+// and drop, so the lookup tables are just rebuilt afterwards.
+void KeyBindTable::RebuildSlots()
+{
+  key_slots.fill(-1);
+  mouse_slots.fill(-1);
+
+  for (unsigned i = 0; i < bindings.size(); i++)
+  {
+    *SlotFor(bindings[i].key) = int16_t(i);
+  }
+}
+
+
+bool KeyBindTable::Bind(int key, const Item &item)
+{
+  const int16_t *slot = SlotFor(key);
+  if (slot == nullptr or *slot >= 0) return false;
+
+  auto it = std::lower_bound(bindings.begin(), bindings.end(), key,
+    [](const KeyBinding &binding, int k) { return binding.key < k; });
+
+  bindings.insert(it, {key, item});
+  RebuildSlots();
+  return true;
+}
+
+
+bool KeyBindTable::Unbind(int key)
+{
+  const int16_t *slot = SlotFor(key);
+  if (slot == nullptr or *slot < 0) return false;
+
+  bindings.erase(bindings.begin() + *slot);
+  RebuildSlots();
+  return true;
+}
+
+
+void KeyBindTable::clear()
+{
+  bindings.clear();
+  RebuildSlots();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// Key bindings for the player's inventory.
+//
+// Inputs are identified by an int: keyboard keys are SDL scancodes, and
+// mouse buttons come after the last scancode (see MouseButtonInput).
+// Lookups go through flat arrays indexed by input, and the bindings
+// themselves are packed together sorted by input, so the per-frame walk
+// over the inventory is a straight run through memory.
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "items.hpp"
+
+
+constexpr int NUM_SCANCODES = 512; //Same as SDL_NUM_SCANCODES
+constexpr int NUM_MOUSE_BUTTONS = 8;
+
+constexpr int MOUSE_INPUT_BASE = NUM_SCANCODES;
+
+
+constexpr int MouseButtonInput(int sdl_button)
+{
+  return MOUSE_INPUT_BASE + sdl_button;
+}
+
+constexpr bool IsMouseInput(int input)
+{
+  return input >= MOUSE_INPUT_BASE;
+}
+
+
+struct KeyBinding
+{
+  int key;
+  Item item;
+};
+
+
+class KeyBindTable
+{
+private:
+  // Index into bindings, or -1 for unbound
+  std::array<int16_t, NUM_SCANCODES> key_slots;
+  std::array<int16_t, NUM_MOUSE_BUTTONS> mouse_slots;
+
+  std::vector<KeyBinding> bindings;
+
+  int16_t *SlotFor(int key)
+  {
+    if (key >= 0 and key < NUM_SCANCODES) return &key_slots[key];
+
+    const int button = key - MOUSE_INPUT_BASE;
+    if (button >= 0 and button < NUM_MOUSE_BUTTONS) return &mouse_slots[button];
+
+    return nullptr;
+  }
+
+  const int16_t *SlotFor(int key) const
+  {
+    return const_cast<KeyBindTable *>(this)->SlotFor(key);
+  }
+
+  void RebuildSlots();
+
+public:
+  KeyBindTable();
+
+  Item *Find(int key)
+  {
+    const int16_t *slot = SlotFor(key);
+    if (slot == nullptr or *slot < 0) return nullptr;
+    return &bindings[*slot].item;
+  }
+
+  const Item *Find(int key) const
+  {
+    return const_cast<KeyBindTable *>(this)->Find(key);
+  }
+
+  bool Contains(int key) const { return Find(key) != nullptr; }
+
+  // Returns false if the key is already bound, or can't be bound
+  bool Bind(int key, const Item &item);
+  bool Unbind(int key);
+
+  void clear();
+  int size() const { return int(bindings.size()); }
+  bool empty() const { return bindings.empty(); }
+
+  // In input order, like the std::map this replaced
+  auto begin() { return bindings.begin(); }
+  auto end() { return bindings.end(); }
+  auto begin() const { return bindings.begin(); }
+  auto end() const { return bindings.end(); }
+};
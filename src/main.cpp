@@ -3,13 +3,25 @@
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 
 constexpr int SWAP_INTERVAL{1};
 
+// Simulation runs at a fixed rate, independent of the display refresh
+constexpr int TICK_RATE{120};
+constexpr int MAX_TICKS_PER_FRAME{8};
+
 constexpr int GL_MAJOR{3};
 constexpr int GL_MINOR{3};
 
+// F5 saves the whole game state here, F9 restores it
+constexpr const char *QUICKSAVE_FILE{"quicksave.snap"};
+
+// Holding F6 runs the game backwards, as far back as this
+constexpr int REWIND_SECONDS{10};
+
 constexpr int WIDTH = 1280;
 constexpr int HEIGHT = 768;
 
@@ -27,11 +39,58 @@ constexpr bool TEST_TASKS = true;
 #include "game.hpp"
 #include "maths.hpp"
 #include "renderer.hpp"
+#include "replay.hpp"
+#include "rewind.hpp"
+#include "run_options.hpp"
+#include "snapshot.hpp"
 #include "sound.hpp"
+#include "timestep.hpp"
 #include "to_string.hpp"
 
 
-void ProcessEvents(Game *game, [[maybe_unused]] Renderer *renderer)
+// Returns true if the key was used for saving/loading, and not passed to the game
+bool ProcessQuickSave(Game *game, InputRecorder *recorder, int key)
+{
+  if (key == SDL_SCANCODE_F5)
+  {
+    SaveSnapshot(game->gamestate, QUICKSAVE_FILE);
+    std::cout << "Saved game to " << QUICKSAVE_FILE << std::endl;
+    return true;
+  }
+
+  if (key == SDL_SCANCODE_F9)
+  {
+    // The recording would no longer replay
+    if (recorder)
+    {
+      std::cout << "Can't load a saved game while recording" << std::endl;
+      return true;
+    }
+
+    try
+    {
+      LoadSnapshot(QUICKSAVE_FILE, game->gamestate);
+      std::cout << "Loaded game from " << QUICKSAVE_FILE << std::endl;
+    }
+    catch (std::exception &e)
+    {
+      std::cout << "Could not load game -- " << e.what() << std::endl;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+
+bool IsMetaKey(int key)
+{
+  return key == SDL_SCANCODE_F5 or key == SDL_SCANCODE_F6 or key == SDL_SCANCODE_F9;
+}
+
+
+// Input gets recorded as it is handed to the game, if recorder is set
+void ProcessEvents(Game *game, InputRecorder *recorder, bool *rewinding, [[maybe_unused]] Renderer *renderer)
 {
   SDL_Event event;
   while (SDL_PollEvent(&event))
@@ -43,22 +102,36 @@ void ProcessEvents(Game *game, [[maybe_unused]] Renderer *renderer)
         break;
 
       case SDL_KEYDOWN:
-        game->ProcessKeyInput(event.key.keysym.sym, true);
+        if (event.key.keysym.scancode == SDL_SCANCODE_F6)
+        {
+          *rewinding = (recorder == nullptr);
+          if (recorder) std::cout << "Can't rewind while recording" << std::endl;
+          break;
+        }
+        if (ProcessQuickSave(game, recorder, event.key.keysym.scancode)) break;
+        game->ProcessKeyInput(event.key.keysym.scancode, true);
+        if (recorder) recorder->KeyInput(event.key.keysym.scancode, true);
         break;
       case SDL_KEYUP:
-        game->ProcessKeyInput(event.key.keysym.sym, false);
+        if (event.key.keysym.scancode == SDL_SCANCODE_F6) *rewinding = false;
+        if (IsMetaKey(event.key.keysym.scancode)) break;
+        game->ProcessKeyInput(event.key.keysym.scancode, false);
+        if (recorder) recorder->KeyInput(event.key.keysym.scancode, false);
         break;
 
       case SDL_MOUSEBUTTONDOWN:
         game->ProcessMouseInput(event.button.button, true);
+        if (recorder) recorder->MouseInput(event.button.button, true);
         break;
 
       case SDL_MOUSEBUTTONUP:
         game->ProcessMouseInput(event.button.button, false);
+        if (recorder) recorder->MouseInput(event.button.button, false);
         break;
 
       case SDL_MOUSEMOTION:
         game->ProcessMouseMotion(event.motion.x, event.motion.y);
+        if (recorder) recorder->MouseMotion(event.motion.x, event.motion.y);
         break;
     }
   }
@@ -77,8 +150,12 @@ std::ostream &operator<<(std::ostream &out, const Timer &timer)
   return out << timer.Report() << "ms";
 }
 
-void main_game()
+// If record_file is set, the seeds and every input are saved there on exit,
+// for replaying with "ld40_sim --replay <file>"
+void main_game(const RunOptions &options)
 {
+  const std::string &record_file = options.record_file;
+
   std::cout << "Hello, world" << std::endl;
   std::cout.precision(2);
   std::cout << std::fixed;
@@ -161,11 +238,20 @@ void main_game()
   std::cout << "Max Array Texture Layers: " << max_array_texture_layers << std::endl;
 
 
-  SDL_GL_SetSwapInterval(SWAP_INTERVAL);
+  // Benchmarks want to know how fast frames can go, not the refresh rate
+  SDL_GL_SetSwapInterval(options.bench_frames > 0 ? 0 : SWAP_INTERVAL);
 
   {
+    Sound sound;
+
     Timer timer_game_start;
     Game game;
+    ApplyRunOptions(options, game);
+
+    InputRecorder recorder;
+    InputRecorder *recording = record_file.empty() ? nullptr : &recorder;
+    if (recording) recording->Start(game);
+
     game.NewGame();
     std::cout << "Game state created in " << timer_game_start << std::endl;
 
@@ -180,26 +266,82 @@ void main_game()
     //If in Debug mode, set extra state things here
 #endif
 
-    auto last_time = SDL_GetTicks();
+    FixedTimestep timestep{TICK_RATE, MAX_TICKS_PER_FRAME};
+
+    RewindBuffer rewind{REWIND_SECONDS * TICK_RATE};
+    bool rewinding = false;
+    long tick = 0;
+
+    const double counter_frequency = SDL_GetPerformanceFrequency();
+    auto last_time = SDL_GetPerformanceCounter();
+
+    TimingStats frame_times;
+    TimingStats tick_times;
+    long frames = 0;
 
     // Main Loop
     while (game.gamestate.running)
     {
+      if (options.bench_frames > 0 and frames++ >= options.bench_frames) break;
+      if (options.seconds > 0.0f and game.gamestate.wallclock >= options.seconds) break;
 
-      ProcessEvents(&game, &renderer);
+      ProcessEvents(&game, recording, &rewinding, &renderer);
 
-      auto this_time = SDL_GetTicks();
-      float delta_time = (this_time - last_time) / 1000.0f;
+      auto this_time = SDL_GetPerformanceCounter();
+      double frame_time = (this_time - last_time) / counter_frequency;
       last_time = this_time;
-
-      game.RemoveDeadItems();
-      game.Update(delta_time);
+      if (options.bench_frames > 0) frame_times.Add(frame_time * 1000.0);
+
+      int ticks = timestep.Advance(frame_time);
+      for (int i = 0; i < ticks; i++)
+      {
+        if (rewinding)
+        {
+          // Step back a tick and forget the future, so it gets re-simulated
+          if (rewind.Restore(tick - 2, game.gamestate))
+          {
+            rewind.Truncate(tick - 2);
+            tick--;
+          }
+          continue;
+        }
+
+        auto tick_start = SDL_GetPerformanceCounter();
+        game.Tick(timestep.TickLength());
+        if (options.bench_frames > 0)
+        {
+          tick_times.Add((SDL_GetPerformanceCounter() - tick_start) * 1000.0 / counter_frequency);
+        }
+
+        if (recording) recording->EndTick(game);
+        rewind.Record(tick++, game.gamestate);
+      }
 
       // Render
-      renderer.RenderAll(game);
+      renderer.RenderAll(game, timestep.Alpha(), timestep.TickLength());
       SDL_GL_SwapWindow(window);
 
     } // end main loop
+
+    std::cout << "Simulated " << timestep.TotalTicks() << " ticks ("
+              << timestep.DroppedTicks() << " dropped)" << std::endl;
+    if (options.bench_frames > 0)
+    {
+      frame_times.Print(std::cout, "Frame times");
+      tick_times.Print(std::cout, "Tick times");
+    }
+    const ProjectileStore::Counters &pool = game.gamestate.world_projectiles.GetCounters();
+    std::cout << "Projectile pool: peak " << pool.peak << " of " << game.gamestate.world_projectiles.Capacity()
+              << "   spawned " << pool.spawned << "   dropped " << pool.dropped
+              << "   refused " << pool.refused << std::endl;
+    std::cout << "Rewind history: " << rewind.Ticks() << " ticks in "
+              << (rewind.MemoryUsed() / 1024) << "KB" << std::endl;
+
+    if (recording)
+    {
+      recording->GetRecording().Save(record_file);
+      std::cout << "Saved replay to " << record_file << std::endl;
+    }
   }
   //Clean up
 
@@ -230,7 +372,7 @@ void run_tests()
 constexpr bool CATCH_EXCEPTIONS = true;
 
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[])
+int main(int argc, char *argv[])
 {
   if constexpr (RUN_TESTS)
   {
@@ -240,11 +382,22 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[])
 
   std::cout << "CPP version: " << CPPVersion() << std::endl;
 
+  RunOptions options;
+  try
+  {
+    options = ParseRunOptions(std::vector<std::string>(argv + 1, argv + argc));
+  }
+  catch (std::exception &e)
+  {
+    std::cout << e.what() << "\n\nOptions:\n" << RUN_OPTIONS_USAGE;
+    return EXIT_FAILURE;
+  }
+
   if constexpr (CATCH_EXCEPTIONS)
   {
     try
     {
-      main_game();
+      main_game(options);
     }
     catch (std::exception &e)
     {
@@ -254,7 +407,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[])
   else
   {
 
-    main_game();
+    main_game(options);
   }
 
   return EXIT_SUCCESS;
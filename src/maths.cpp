@@ -257,6 +257,12 @@ float clamp(float min, float max, float val)
 }
 
 
+vec2 lerp(vec2 const &from, vec2 const &to, float t)
+{
+  return from + (to - from) * t;
+}
+
+
 float RandomFloat()
 {
   return static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
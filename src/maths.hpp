@@ -46,6 +46,7 @@ vec2 get_intersection(vec2 ps1, vec2 pe1, vec2 ps2, vec2 pe2); //Throws
 
 bool in_range(float beg, float end, float p);
 float clamp(float min, float max, float val);
+vec2 lerp(vec2 const &from, vec2 const &to, float t);
 
 
 float RandomFloat();
@@ -0,0 +1,96 @@
+#include "occupancy_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+void OccupancyGrid::Resize(vec2 min, vec2 max, float new_cell_size)
+{
+  cell_size = std::max(new_cell_size, 1.0f);
+  origin = min;
+  columns = std::max(int(std::ceil((max.x - min.x) / cell_size)), 1);
+  rows = std::max(int(std::ceil((max.y - min.y) / cell_size)), 1);
+
+  blocked.assign(columns * rows, 0);
+  version++;
+}
+
+
+void OccupancyGrid::SetBlocked(vec2 position, bool is_blocked)
+{
+  if (blocked.empty()) return;
+
+  const int cell = CellAt(position);
+  if (blocked[cell] != is_blocked)
+  {
+    blocked[cell] = is_blocked;
+    version++;
+  }
+}
+
+
+void OccupancyGrid::ClearBlocked()
+{
+  std::fill(blocked.begin(), blocked.end(), 0);
+  version++;
+}
+
+
+int OccupancyGrid::CellX(float x) const
+{
+  int cx = int(std::floor((x - origin.x) / cell_size));
+  return std::min(std::max(cx, 0), columns - 1);
+}
+
+
+int OccupancyGrid::CellY(float y) const
+{
+  int cy = int(std::floor((y - origin.y) / cell_size));
+  return std::min(std::max(cy, 0), rows - 1);
+}
+
+
+bool OccupancyGrid::LineOfSight(vec2 from, vec2 to) const
+{
+  if (blocked.empty()) return true;
+
+  // In cell units
+  const float fx = (from.x - origin.x) / cell_size;
+  const float fy = (from.y - origin.y) / cell_size;
+  const float dx = (to.x - origin.x) / cell_size - fx;
+  const float dy = (to.y - origin.y) / cell_size - fy;
+
+  int cx = int(std::floor(fx));
+  int cy = int(std::floor(fy));
+  const int end_x = int(std::floor(fx + dx));
+  const int end_y = int(std::floor(fy + dy));
+
+  const int step_x = dx > 0.0f ? 1 : -1;
+  const int step_y = dy > 0.0f ? 1 : -1;
+
+  // How far along the line (0 to 1) each cell boundary crossing is
+  constexpr float never = std::numeric_limits<float>::infinity();
+  const float delta_x = dx != 0.0f ? std::abs(1.0f / dx) : never;
+  const float delta_y = dy != 0.0f ? std::abs(1.0f / dy) : never;
+  float next_x = dx != 0.0f ? (dx > 0.0f ? (cx + 1 - fx) : (fx - cx)) * delta_x : never;
+  float next_y = dy != 0.0f ? (dy > 0.0f ? (cy + 1 - fy) : (fy - cy)) * delta_y : never;
+
+  int steps = std::abs(end_x - cx) + std::abs(end_y - cy);
+  while (true)
+  {
+    if (cx >= 0 and cx < columns and cy >= 0 and cy < rows and blocked[cy * columns + cx]) return false;
+    if (steps-- <= 0) return true;
+
+    if (next_x < next_y)
+    {
+      cx += step_x;
+      next_x += delta_x;
+    }
+    else
+    {
+      cy += step_y;
+      next_y += delta_y;
+    }
+  }
+}
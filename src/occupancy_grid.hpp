@@ -0,0 +1,48 @@
+#pragma once
+
+// Coarse grid of which parts of the world are blocked, for pathing and line
+// of sight.  Positions outside it are clamped to the edge cells.
+
+#include <cstdint>
+#include <vector>
+
+#include "maths_types.hpp"
+
+
+class OccupancyGrid
+{
+private:
+  vec2 origin{0.0f, 0.0f};
+  float cell_size = 1.0f;
+  int columns = 0;
+  int rows = 0;
+
+  std::vector<uint8_t> blocked;
+
+  // Goes up whenever a cell changes, so users can tell they're out of date
+  uint32_t version = 0;
+
+public:
+  // Covers min to max, with nothing blocked
+  void Resize(vec2 min, vec2 max, float new_cell_size);
+
+  void SetBlocked(vec2 position, bool is_blocked);
+  void ClearBlocked();
+
+  int CellX(float x) const;
+  int CellY(float y) const;
+  int CellAt(vec2 position) const { return CellY(position.y) * columns + CellX(position.x); }
+
+  bool Blocked(int cell) const { return blocked[cell]; }
+  bool Blocked(int cx, int cy) const { return blocked[cy * columns + cx]; }
+
+  // Walks the cells the line passes through (DDA), true if none are blocked.
+  // The parts of the line off the grid don't hit anything.
+  bool LineOfSight(vec2 from, vec2 to) const;
+
+  int Columns() const { return columns; }
+  int Rows() const { return rows; }
+  int Cells() const { return columns * rows; }
+  float CellSize() const { return cell_size; }
+  uint32_t Version() const { return version; }
+};
@@ -0,0 +1,421 @@
+#include "projectiles.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "simd.hpp"
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+ProjectileStore::ProjectileStore(int capacity, Overflow_Policy overflow)
+{
+  SetCapacity(capacity, overflow);
+}
+
+
+void ProjectileStore::SetCapacity(int new_capacity, Overflow_Policy new_overflow)
+{
+  capacity = std::max(new_capacity, 0);
+  overflow = new_overflow;
+
+  // Shrink the arrays too, they might have been much bigger before
+  for (std::vector<float> *column : {&x, &y, &last_x, &last_y, &vx, &vy, &expire_time, &radius})
+  {
+    std::vector<float>().swap(*column);
+  }
+  std::vector<int>().swap(damage);
+  std::vector<uint8_t>().swap(hostile);
+  std::vector<uint32_t>().swap(dense_slot);
+
+  slot_dense.assign(capacity, 0);
+  slot_generation.assign(capacity, 1);
+  slot_older.assign(capacity, -1);
+  slot_newer.assign(capacity, -1);
+
+  Reserve();
+  clear();
+  counters = {};
+}
+
+
+// After a copy the arrays are only as big as they need to be
+void ProjectileStore::Reserve()
+{
+  for (std::vector<float> *column : {&x, &y, &last_x, &last_y, &vx, &vy, &expire_time, &radius})
+  {
+    column->reserve(capacity);
+  }
+  damage.reserve(capacity);
+  hostile.reserve(capacity);
+  dense_slot.reserve(capacity);
+  free_slots.reserve(capacity);
+  expiry.reserve(capacity * 2);
+  expired.reserve(capacity);
+}
+
+
+void ProjectileStore::clear()
+{
+  x.clear();
+  y.clear();
+  last_x.clear();
+  last_y.clear();
+  vx.clear();
+  vy.clear();
+  expire_time.clear();
+  radius.clear();
+  damage.clear();
+  hostile.clear();
+  dense_slot.clear();
+
+  // Handed out lowest first
+  free_slots.clear();
+  for (int slot = capacity - 1; slot >= 0; slot--)
+  {
+    slot_generation[slot]++;
+    if (slot_generation[slot] == 0) slot_generation[slot] = 1;
+    free_slots.push_back(slot);
+  }
+
+  oldest = newest = -1;
+
+  expiry.clear();
+}
+
+
+SlotHandle ProjectileStore::Add(const Projectile &p)
+{
+  if (size() >= capacity)
+  {
+    // With no room at all there's nothing to drop either
+    if (overflow == Overflow_Policy::refuse or empty())
+    {
+      counters.refused++;
+      return {};
+    }
+
+    Remove(slot_dense[oldest]);
+    counters.dropped++;
+  }
+
+  if (x.capacity() < size_t(capacity)) Reserve();
+
+  const uint32_t slot = free_slots.back();
+  free_slots.pop_back();
+
+  slot_dense[slot] = uint32_t(size());
+  dense_slot.push_back(slot);
+
+  slot_older[slot] = newest;
+  slot_newer[slot] = -1;
+  if (newest >= 0) slot_newer[newest] = slot;
+  newest = slot;
+  if (oldest < 0) oldest = slot;
+
+  x.push_back(p.position.x);
+  y.push_back(p.position.y);
+  last_x.push_back(p.last_position.x);
+  last_y.push_back(p.last_position.y);
+  vx.push_back(p.velocity.x);
+  vy.push_back(p.velocity.y);
+  expire_time.push_back(p.expire_time);
+  radius.push_back(p.radius);
+  damage.push_back(p.damage);
+  hostile.push_back(p.hostile);
+
+  const SlotHandle handle{slot, slot_generation[slot]};
+  expiry.Schedule(TimerTick(p.expire_time), handle);
+
+  counters.spawned++;
+  counters.peak = std::max(counters.peak, size());
+
+  return handle;
+}
+
+
+Projectile ProjectileStore::Get(int index) const
+{
+  Projectile p;
+  p.position = {x[index], y[index]};
+  p.last_position = {last_x[index], last_y[index]};
+  p.velocity = {vx[index], vy[index]};
+  p.expire_time = expire_time[index];
+  p.radius = radius[index];
+  p.damage = damage[index];
+  p.hostile = hostile[index];
+  return p;
+}
+
+
+///////////////////////////////////////
+
+
+struct IntegrateArrays
+{
+  float *x;
+  float *y;
+  float *last_x;
+  float *last_y;
+  const float *vx;
+  const float *vy;
+};
+
+
+// Handles whatever is left over after the SIMD loops too
+void IntegrateScalar(IntegrateArrays a, int begin, int end, float dt)
+{
+  for (int i = begin; i < end; i++)
+  {
+    a.last_x[i] = a.x[i];
+    a.last_y[i] = a.y[i];
+    a.x[i] += a.vx[i] * dt;
+    a.y[i] += a.vy[i] * dt;
+  }
+}
+
+
+#if SIMD_X86
+
+SIMD_TARGET_SSE2
+void IntegrateSSE2(IntegrateArrays a, int count, float dt)
+{
+  const __m128 vdt = _mm_set1_ps(dt);
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 px = _mm_loadu_ps(a.x + i);
+    __m128 py = _mm_loadu_ps(a.y + i);
+    _mm_storeu_ps(a.last_x + i, px);
+    _mm_storeu_ps(a.last_y + i, py);
+
+    px = _mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(a.vx + i), vdt));
+    py = _mm_add_ps(py, _mm_mul_ps(_mm_loadu_ps(a.vy + i), vdt));
+    _mm_storeu_ps(a.x + i, px);
+    _mm_storeu_ps(a.y + i, py);
+  }
+
+  IntegrateScalar(a, i, count, dt);
+}
+
+
+SIMD_TARGET_AVX2
+void IntegrateAVX2(IntegrateArrays a, int count, float dt)
+{
+  const __m256 vdt = _mm256_set1_ps(dt);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 px = _mm256_loadu_ps(a.x + i);
+    __m256 py = _mm256_loadu_ps(a.y + i);
+    _mm256_storeu_ps(a.last_x + i, px);
+    _mm256_storeu_ps(a.last_y + i, py);
+
+    px = _mm256_add_ps(px, _mm256_mul_ps(_mm256_loadu_ps(a.vx + i), vdt));
+    py = _mm256_add_ps(py, _mm256_mul_ps(_mm256_loadu_ps(a.vy + i), vdt));
+    _mm256_storeu_ps(a.x + i, px);
+    _mm256_storeu_ps(a.y + i, py);
+  }
+
+  IntegrateScalar(a, i, count, dt);
+}
+
+#endif
+
+
+void ProjectileStore::Integrate(float dt)
+{
+  Integrate(dt, 0, size());
+}
+
+
+void ProjectileStore::Integrate(float dt, int begin, int end)
+{
+  IntegrateArrays a{x.data() + begin, y.data() + begin, last_x.data() + begin, last_y.data() + begin,
+    vx.data() + begin, vy.data() + begin};
+
+  const int count = end - begin;
+
+#if SIMD_X86
+  switch (GetSimdLevel())
+  {
+    case SimdLevel::avx2:
+      return IntegrateAVX2(a, count, dt);
+    case SimdLevel::sse2:
+      return IntegrateSSE2(a, count, dt);
+    case SimdLevel::scalar:
+      break;
+  }
+#endif
+
+  IntegrateScalar(a, 0, count, dt);
+}
+
+
+bool ProjectileStore::Contains(SlotHandle handle) const
+{
+  return handle.index < slot_generation.size() and slot_generation[handle.index] == handle.generation;
+}
+
+
+int ProjectileStore::IndexOf(SlotHandle handle) const
+{
+  return Contains(handle) ? int(slot_dense[handle.index]) : -1;
+}
+
+
+SlotHandle ProjectileStore::HandleAt(int index) const
+{
+  const uint32_t slot = dense_slot[index];
+  return {slot, slot_generation[slot]};
+}
+
+
+void ProjectileStore::Unlink(uint32_t slot)
+{
+  const int older = slot_older[slot];
+  const int newer = slot_newer[slot];
+
+  if (older >= 0) slot_newer[older] = newer;
+  else oldest = newer;
+
+  if (newer >= 0) slot_older[newer] = older;
+  else newest = older;
+}
+
+
+void ProjectileStore::Remove(int index)
+{
+  const uint32_t slot = dense_slot[index];
+  Unlink(slot);
+
+  slot_generation[slot]++;
+  if (slot_generation[slot] == 0) slot_generation[slot] = 1;
+  free_slots.push_back(slot);
+
+  const int last = size() - 1;
+  if (index != last)
+  {
+    x[index] = x[last];
+    y[index] = y[last];
+    last_x[index] = last_x[last];
+    last_y[index] = last_y[last];
+    vx[index] = vx[last];
+    vy[index] = vy[last];
+    expire_time[index] = expire_time[last];
+    radius[index] = radius[last];
+    damage[index] = damage[last];
+    hostile[index] = hostile[last];
+
+    dense_slot[index] = dense_slot[last];
+    slot_dense[dense_slot[index]] = index;
+  }
+
+  x.pop_back();
+  y.pop_back();
+  last_x.pop_back();
+  last_y.pop_back();
+  vx.pop_back();
+  vy.pop_back();
+  expire_time.pop_back();
+  radius.pop_back();
+  damage.pop_back();
+  hostile.pop_back();
+  dense_slot.pop_back();
+}
+
+
+bool ProjectileStore::Remove(SlotHandle handle)
+{
+  const int index = IndexOf(handle);
+  if (index < 0) return false;
+
+  Remove(index);
+  return true;
+}
+
+
+void ProjectileStore::Expire(int index, float now)
+{
+  expire_time[index] = now;
+  expiry.Schedule(expiry.Now(), HandleAt(index));
+}
+
+
+void ProjectileStore::RemoveExpired(float now)
+{
+  expired.clear();
+  expiry.Advance(TimerTick(now), [&](SlotHandle handle) {
+    const int index = IndexOf(handle);
+    if (index < 0) return;
+
+    // Due some time in this wheel tick, not necessarily yet
+    if (expire_time[index] > now)
+    {
+      expiry.Schedule(TimerTick(expire_time[index]) + 1, handle);
+      return;
+    }
+    expired.push_back(index);
+  });
+
+  // Highest index first, so the one swapped into a gap is never one still to
+  // go, and the result does not depend on the order the timers went off in
+  std::sort(expired.begin(), expired.end(), std::greater<int>());
+  expired.erase(std::unique(expired.begin(), expired.end()), expired.end());
+
+  for (int index : expired)
+  {
+    Remove(index);
+  }
+}
+
+
+void ProjectileStore::RebuildSlots(float now)
+{
+  if (size() > capacity)
+  {
+    // Keep what was read in, SetCapacity() would throw it away
+    const int count = size();
+    capacity = count;
+    slot_dense.resize(capacity);
+    slot_generation.resize(capacity, 1);
+    slot_older.resize(capacity);
+    slot_newer.resize(capacity);
+  }
+
+  for (int slot = 0; slot < capacity; slot++)
+  {
+    slot_generation[slot]++;
+    if (slot_generation[slot] == 0) slot_generation[slot] = 1;
+  }
+
+  const int count = size();
+  dense_slot.resize(count);
+  for (int i = 0; i < count; i++)
+  {
+    dense_slot[i] = i;
+    slot_dense[i] = i;
+    slot_older[i] = i - 1;
+    slot_newer[i] = (i + 1 < count) ? i + 1 : -1;
+  }
+  oldest = (count > 0) ? 0 : -1;
+  newest = count - 1;
+
+  free_slots.clear();
+  for (int slot = capacity - 1; slot >= count; slot--)
+  {
+    free_slots.push_back(slot);
+  }
+
+  Reserve();
+
+  expiry.clear(TimerTick(now));
+  for (int i = 0; i < count; i++)
+  {
+    expiry.Schedule(TimerTick(expire_time[i]), HandleAt(i));
+  }
+}
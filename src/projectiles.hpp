@@ -0,0 +1,140 @@
+#pragma once
+
+// Projectiles stored as a structure of arrays, so the per tick update is a
+// straight run over a few float arrays that the compiler/SIMD can chew through.
+
+#include <cstdint>
+#include <vector>
+
+#include "maths_types.hpp"
+#include "timer_wheel.hpp"
+#include "utils.hpp"
+
+
+struct Projectile
+{
+  vec2 position{0.0f, 0.0f};
+  vec2 last_position{0.0f, 0.0f};
+  vec2 velocity{0.0f, 0.0f};
+  int damage;
+  float radius;
+
+  // Fired by monsters, so it hits the player rather than them
+  bool hostile = false;
+
+  // Game time it disappears at
+  float expire_time = 0.0f;
+};
+
+
+// What to do with a new projectile when the store is already full
+enum class Overflow_Policy
+{
+  refuse,
+  drop_oldest
+};
+
+
+constexpr int DEFAULT_PROJECTILE_CAPACITY{4096};
+
+
+// Fixed capacity, everything is allocated up front so spawning never does.
+// Expiry goes through a timer wheel, so only projectiles that are due get
+// looked at.
+// The arrays stay packed (removal swaps the last projectile into the gap) so
+// the update can run straight over them, while a slot table on the side gives
+// each projectile a stable handle, and keeps them in order of age for
+// Overflow_Policy::drop_oldest.
+class ProjectileStore
+{
+public:
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> last_x;
+  std::vector<float> last_y;
+  std::vector<float> vx;
+  std::vector<float> vy;
+  std::vector<float> expire_time;
+  std::vector<float> radius;
+  std::vector<int> damage;
+  std::vector<uint8_t> hostile;
+
+  struct Counters
+  {
+    long spawned = 0;
+    long refused = 0;
+    long dropped = 0; // Removed to make room, by Overflow_Policy::drop_oldest
+    int peak = 0;
+  };
+
+private:
+  int capacity;
+  Overflow_Policy overflow;
+
+  // Slot of each packed projectile, and the packed index of each slot
+  std::vector<uint32_t> dense_slot;
+  std::vector<uint32_t> slot_dense;
+  std::vector<uint32_t> slot_generation;
+  std::vector<uint32_t> free_slots;
+
+  // Slots in order of spawning, as a linked list
+  std::vector<int> slot_older;
+  std::vector<int> slot_newer;
+  int oldest = -1;
+  int newest = -1;
+
+  Counters counters;
+
+  TimerWheel<SlotHandle> expiry;
+  std::vector<int> expired;
+
+  void Reserve();
+  void Unlink(uint32_t slot);
+
+public:
+  explicit ProjectileStore(int capacity = DEFAULT_PROJECTILE_CAPACITY,
+                           Overflow_Policy overflow = Overflow_Policy::drop_oldest);
+
+  // Empties the store
+  void SetCapacity(int new_capacity, Overflow_Policy new_overflow);
+
+  int size() const { return int(x.size()); }
+  bool empty() const { return x.empty(); }
+
+  // Also starts the clock for RemoveExpired() over from zero
+  void clear();
+
+  int Capacity() const { return capacity; }
+  Overflow_Policy Overflow() const { return overflow; }
+  const Counters &GetCounters() const { return counters; }
+  void ResetCounters() { counters = {}; }
+
+  // Returns a null handle if the store was full and refused it
+  SlotHandle Add(const Projectile &p);
+  Projectile Get(int index) const;
+
+  bool Contains(SlotHandle handle) const;
+  int IndexOf(SlotHandle handle) const; // -1 if gone
+  SlotHandle HandleAt(int index) const;
+
+  vec2 Position(int index) const { return {x[index], y[index]}; }
+
+  // Moves everything along
+  void Integrate(float dt);
+  void Integrate(float dt, int begin, int end);
+
+  // Swaps the last projectile into the gap, so order is not kept
+  void Remove(int index);
+  bool Remove(SlotHandle handle);
+
+  // Gone at the next RemoveExpired(), now being the current game time
+  void Expire(int index, float now);
+
+  // Removes everything with an expire_time up to now.  Only looks at the ones
+  // whose timer has gone off, not at every projectile.
+  void RemoveExpired(float now);
+
+  // For after the arrays have been filled in directly (e.g. from a snapshot).
+  // Every projectile gets a new handle, and is treated as spawned in array order.
+  void RebuildSlots(float now);
+};
@@ -1,6 +1,7 @@
 
 #include "renderer.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <vector>
@@ -115,13 +116,15 @@ std::string GetHealthText(const Health &health)
 
 void Renderer::RenderPlayer(const Player &player)
 {
-  lines1.Circle(player.position, player.radius, green);
+  vec2 position = lerp(player.last_position, player.position, interpolation);
+
+  lines1.Circle(position, player.radius, green);
 
   vec2 direction = normalize(player.direction);
-  vec2 facing_circle = player.position + (direction * player.radius);
+  vec2 facing_circle = position + (direction * player.radius);
   lines1.Circle(facing_circle, player.radius / 4.0f, green);
 
-  TextBox box{text_data, *font_small, player.position + vec2{-20.0f, player.radius}};
+  TextBox box{text_data, *font_small, position + vec2{-20.0f, player.radius}};
   box << white << "Player" << box.endl
       << green << GetHealthText(player.health);
 }
@@ -129,28 +132,30 @@ void Renderer::RenderPlayer(const Player &player)
 
 void Renderer::RenderItem(const Item &item, bool colliding, bool moused_over)
 {
-  lines1.Circle(item.position, item.radius, item.colour);
+  vec2 position = lerp(item.last_position, item.position, interpolation);
+
+  lines1.Circle(position, item.radius, item.colour);
 
   if (not item.animation.empty())
   {
     auto anim = sprite_factory.GetAnimation(item.animation);
 
-    auto sprite = anim.GetFrame(item.animation_time);
-    RenderSprite(sprite, item.position, item.colour);
+    auto sprite = anim.GetFrame(game_time + item.animation_offset);
+    RenderSprite(sprite, position, item.colour);
   }
   else
     switch (item.type)
     {
       case Item_Type::gun:
-        RenderSprite(sprite_factory.GetSprite("gun_shadow"), item.position, white);
-        RenderSprite(sprite_factory.GetSprite("gun_base"), item.position, white);
-        RenderSprite(sprite_factory.GetSprite("gun_top"), item.position, item.colour);
+        RenderSprite(sprite_factory.GetSprite("gun_shadow"), position, white);
+        RenderSprite(sprite_factory.GetSprite("gun_base"), position, white);
+        RenderSprite(sprite_factory.GetSprite("gun_top"), position, item.colour);
         break;
 
       case Item_Type::health:
-        RenderSprite(sprite_factory.GetSprite("healthkit_shadow"), item.position, white);
-        RenderSprite(sprite_factory.GetSprite("healthkit_base"), item.position, white);
-        RenderSprite(sprite_factory.GetSprite("healthkit_top"), item.position, item.colour);
+        RenderSprite(sprite_factory.GetSprite("healthkit_shadow"), position, white);
+        RenderSprite(sprite_factory.GetSprite("healthkit_base"), position, white);
+        RenderSprite(sprite_factory.GetSprite("healthkit_top"), position, item.colour);
         break;
 
       case Item_Type::command:
@@ -161,18 +166,19 @@ void Renderer::RenderItem(const Item &item, bool colliding, bool moused_over)
   if (colliding)
   {
     float r1 = item.radius + (oscilate * 5);
-    lines1.Circle(item.position, r1, white);
+    lines1.Circle(position, r1, white);
   }
 
   if (moused_over)
   {
     float r1 = item.radius + (oscilate * 5);
-    lines1.Circle(item.position, r1, white);
+    lines1.Circle(position, r1, white);
   }
   else
   {
-    TextBox box(text_data, *font_small, item.position + vec2{-20.0f, item.radius});
+    TextBox box(text_data, *font_small, position + vec2{-20.0f, item.radius});
     box << grey << item.name;
+    if (item.count > 1) box << white << " (" << item.count << ")";
   }
 }
 
@@ -193,7 +199,7 @@ std::string GetLimitedUsesText(const Item &item, bool inv_view)
 }
 
 
-std::string GetCooldownText(const Item &item, bool inv_view)
+std::string GetCooldownText(const Item &item, float now, bool inv_view)
 {
   assert(item.has_cooldown);
 
@@ -201,7 +207,7 @@ std::string GetCooldownText(const Item &item, bool inv_view)
   SetStreamFormat(ss);
   if (inv_view)
   {
-    ss << "  [" << item.cooldown << "s]";
+    ss << "  [" << item.CooldownLeft(now) << "s]";
   }
   else
   {
@@ -247,6 +253,11 @@ void Renderer::RenderItemInfoCard(const Item &item, const vec2 &mouse_pos)
       box << grey << "[None]" << box.endl;
   }
 
+  if (item.count > 1)
+  {
+    box << grey << "Stack of " << green << item.count << box.endl;
+  }
+
   if (item.has_limited_uses)
   {
     box << grey << "Limited uses: " << green << GetLimitedUsesText(item, false) << box.endl;
@@ -254,7 +265,7 @@ void Renderer::RenderItemInfoCard(const Item &item, const vec2 &mouse_pos)
 
   if (item.has_cooldown)
   {
-    box << grey << "Cooldown: " << green << GetCooldownText(item, false) << box.endl;
+    box << grey << "Cooldown: " << green << GetCooldownText(item, game_time, false) << box.endl;
   }
 
   //   case Active_Type::none:
@@ -273,9 +284,10 @@ void Renderer::RenderItemInfoCard(const Item &item, const vec2 &mouse_pos)
   {
     box << grey << "Animation: '" << item.animation << "'";
 
-    float fm = fmod(item.animation_time, 1.0f);
+    const float animation_time = game_time + item.animation_offset;
+    float fm = fmod(animation_time, 1.0f);
     int im = fm * 3;
-    box << green << "[" << item.animation_time << "]  fmod(" << fm << ") ->int = " << im << box.endl;
+    box << green << "[" << animation_time << "]  fmod(" << fm << ") ->int = " << im << box.endl;
   }
 
   auto[box_topleft, box_size] = box.GetRect(5.0f);
@@ -286,16 +298,24 @@ void Renderer::RenderItemInfoCard(const Item &item, const vec2 &mouse_pos)
 
 void Renderer::RenderMonster(const Monster &monster, bool moused_over)
 {
-  lines1.Circle(monster.position, monster.radius, red);
+  // Monsters that only move every few ticks are spread over the whole step
+  float t = interpolation;
+  if (monster.step_dt > 0.0f)
+  {
+    t = std::min((game_time - monster.moved_at + interpolation * tick_length) / monster.step_dt, 1.0f);
+  }
+  vec2 position = lerp(monster.last_position, monster.position, t);
+
+  lines1.Circle(position, monster.radius, red);
 
   if (moused_over)
   {
     float r1 = monster.radius + (oscilate * 5);
-    lines1.Circle(monster.position, r1, white);
+    lines1.Circle(position, r1, white);
   }
   else
   {
-    TextBox box(text_data, *font_small, monster.position + vec2{-20.0f, monster.radius});
+    TextBox box(text_data, *font_small, position + vec2{-20.0f, monster.radius});
     box << grey << monster.name;
   }
 }
@@ -338,11 +358,13 @@ void Renderer::RenderMonsterInfoCard(const Monster &monster, const vec2 &mouse_p
 
 void Renderer::RenderProjectile(const Projectile &projectile)
 {
-  lines1.Circle(projectile.position, projectile.radius, white);
+  vec2 position = lerp(projectile.last_position, projectile.position, interpolation);
+
+  lines1.Circle(position, projectile.radius, white);
 }
 
 
-void Renderer::RenderInventory(std::map<int, Item> inventory)
+void Renderer::RenderInventory(const KeyBindTable &inventory)
 {
   TextBox box(text_data, *font_infocard_title, {10.0f, 30.0f});
 
@@ -353,14 +375,19 @@ void Renderer::RenderInventory(std::map<int, Item> inventory)
   {
     box << grey << GetInputName(key) << ": " << item.name;
 
+    if (item.count > 1)
+    {
+      box << white << " (" << item.count << ")";
+    }
+
     if (item.has_limited_uses)
     {
       box << red << GetLimitedUsesText(item, true);
     }
 
-    if (item.has_cooldown and item.cooldown > 0.0f)
+    if (item.has_cooldown and item.CooldownLeft(game_time) > 0.0f)
     {
-      box << green << GetCooldownText(item, true);
+      box << green << GetCooldownText(item, game_time, true);
     }
 
     box << box.endl;
@@ -371,8 +398,20 @@ void Renderer::RenderInventory(std::map<int, Item> inventory)
 }
 
 
-void Renderer::RenderGame(const GameState &state)
+void Renderer::RenderWalls(const SegmentBVH &walls)
+{
+  for (int i = 0; i < walls.size(); i++)
+  {
+    lines1.Line(walls[i].a, grey, walls[i].b, grey);
+  }
+}
+
+
+void Renderer::RenderGame(const GameState &state, const SegmentBVH &walls, float alpha, float tick_seconds)
 {
+  interpolation = alpha;
+  tick_length = tick_seconds;
+  game_time = state.wallclock;
   oscilate = sin(state.wallclock * 5.0f);
 
   lines1.clear();
@@ -381,11 +420,16 @@ void Renderer::RenderGame(const GameState &state)
 
   // lines1.Line({150, 150}, red, {500, 500}, green);
 
+  RenderWalls(walls);
 
-  for (auto &item : state.world_items)
+
+  for (int i = 0; i < state.world_items.size(); i++)
   {
-    bool colliding = state.closest_item and state.closest_item == &item;
-    bool moused_over = state.mouseover_item and state.mouseover_item == &item;
+    const Item &item = state.world_items[i];
+    const SlotHandle handle = state.world_items.HandleAt(i);
+
+    bool colliding = state.closest_item == handle;
+    bool moused_over = state.mouseover_item == handle;
 
     RenderItem(item, colliding, moused_over);
     if (moused_over)
@@ -395,9 +439,10 @@ void Renderer::RenderGame(const GameState &state)
   }
 
 
-  for (auto &monster : state.world_monsters)
+  for (int i = 0; i < state.world_monsters.size(); i++)
   {
-    bool moused_over = state.mouseover_monster and state.mouseover_monster == &monster;
+    const Monster &monster = state.world_monsters[i];
+    bool moused_over = state.mouseover_monster == state.world_monsters.HandleAt(i);
 
     RenderMonster(monster, moused_over);
     if (moused_over)
@@ -407,9 +452,9 @@ void Renderer::RenderGame(const GameState &state)
   }
 
 
-  for (auto &projectile : state.world_projectiles)
+  for (int i = 0; i < state.world_projectiles.size(); i++)
   {
-    RenderProjectile(projectile);
+    RenderProjectile(state.world_projectiles.Get(i));
   }
 
 
@@ -439,7 +484,7 @@ void Renderer::RenderGame(const GameState &state)
   }
   else
   {
-    if (state.closest_item)
+    if (state.world_items.Contains(state.closest_item))
     {
       box << "Press a new key to pick up this item";
     }
@@ -487,7 +532,7 @@ void Renderer::RenderGame(const GameState &state)
 }
 
 
-void Renderer::RenderAll(const Game &game)
+void Renderer::RenderAll(const Game &game, float alpha, float tick_seconds)
 {
   if (game.debug.flag1) return RenderProgressBar(0.2f);
   if (game.debug.flag2) return RenderProgressBar(1.0f);
@@ -520,7 +565,7 @@ void Renderer::RenderAll(const Game &game)
   // font_infocard_body = game.debug.flag1 ? fonts.small2 : fonts.small;
   // font_infocard_title = game.debug.flag2 ? fonts.small_serif : fonts.small_bold;
 
-  RenderGame(game.gamestate);
+  RenderGame(game.gamestate, game.walls, alpha, tick_seconds);
 
   GL::CheckError();
 }
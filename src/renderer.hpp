@@ -36,6 +36,13 @@ private:
 
   float oscilate = 0.0f;
 
+  // How far between the previous and current simulation tick to draw things
+  float interpolation = 1.0f;
+  float tick_length = 0.0f;
+
+  // GameState::wallclock, for animations and cooldowns
+  float game_time = 0.0f;
+
   col4 white;
   col4 grey;
   col4 green;
@@ -79,11 +86,13 @@ public:
 
   void RenderProjectile(const Projectile &projectile);
 
-  void RenderInventory(std::map<int, Item> inventory);
+  void RenderInventory(const KeyBindTable &inventory);
+
+  void RenderWalls(const SegmentBVH &walls);
 
-  void RenderGame(const GameState &state);
+  void RenderGame(const GameState &state, const SegmentBVH &walls, float alpha, float tick_seconds);
 
-  void RenderAll(const Game &game);
+  void RenderAll(const Game &game, float alpha, float tick_seconds);
 
 
   void RenderProgressBar(float v);
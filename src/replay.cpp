@@ -0,0 +1,289 @@
+#include "replay.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "game.hpp"
+
+constexpr long CHECKSUM_INTERVAL{60};
+constexpr int REPLAY_VERSION{3};
+
+// Version 1 had no scene line, and always used the default scene.  Version 2
+// had no chunk size at the end of it.
+constexpr int OLDEST_REPLAY_VERSION{1};
+
+
+uint64_t StateChecksum(const GameState &state)
+{
+  uint64_t sum = 14695981039346656037ull;
+  auto mix = [&](uint64_t v) { sum = (sum ^ v) * 1099511628211ull; };
+  auto mix_float = [&](float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    mix(bits);
+  };
+
+  mix_float(state.player.position.x);
+  mix_float(state.player.position.y);
+  mix(uint64_t(state.player.health.current));
+  mix(uint64_t(state.player.KeyBindInventory.size()));
+  for (auto &binding : state.player.KeyBindInventory)
+  {
+    mix(uint64_t(binding.item.count));
+  }
+
+  mix(uint64_t(state.world_items.size()));
+  for (auto &item : state.world_items)
+  {
+    mix_float(item.position.x);
+    mix_float(item.position.y);
+    mix(uint64_t(item.count));
+  }
+
+  for (auto &monster : state.world_monsters)
+  {
+    mix_float(monster.position.x);
+    mix_float(monster.position.y);
+    mix(uint64_t(monster.health.current));
+    mix_float(monster.fire_ready);
+    mix_float(monster.moved_at);
+  }
+
+  const ProjectileStore &projectiles = state.world_projectiles;
+  for (int i = 0; i < projectiles.size(); i++)
+  {
+    mix_float(projectiles.x[i]);
+    mix_float(projectiles.y[i]);
+    mix_float(projectiles.expire_time[i]);
+    mix(projectiles.hostile[i]);
+  }
+
+  for (ChunkCoord coord : state.loaded_chunks)
+  {
+    mix(uint32_t(coord.x));
+    mix(uint32_t(coord.y));
+  }
+  for (const SavedChunk &chunk : state.saved_chunks)
+  {
+    mix(uint32_t(chunk.coord.x));
+    mix(uint32_t(chunk.coord.y));
+    mix(chunk.snapshot.size());
+  }
+
+  return sum;
+}
+
+
+///////////////////////////////////////
+
+
+void Recording::Save(const std::string &filename) const
+{
+  std::ofstream out(filename);
+  if (not out)
+  {
+    throw std::runtime_error("Could not write replay file " + filename);
+  }
+
+  out << "ld40_replay " << REPLAY_VERSION << "\n";
+  out << "seeds " << game_seed << " " << factory_seed << "\n";
+  out << "ticks " << total_ticks << "\n";
+
+  out.precision(9);
+  out << "scene " << scene.num_items << " " << scene.num_monsters << " " << scene.num_projectiles << " "
+      << scene.world_min.x << " " << scene.world_min.y << " " << scene.world_max.x << " " << scene.world_max.y << " "
+      << scene.chunk_size << "\n";
+
+  for (auto &e : events)
+  {
+    switch (e.type)
+    {
+      case Input_Type::key:
+        out << "k ";
+        break;
+      case Input_Type::mouse_button:
+        out << "b ";
+        break;
+      case Input_Type::mouse_motion:
+        out << "m ";
+        break;
+    }
+    out << e.tick << " " << e.a << " " << e.b << "\n";
+  }
+
+  for (unsigned i = 0; i < checksums.size(); i++)
+  {
+    out << "c " << ((i + 1) * CHECKSUM_INTERVAL) << " " << checksums[i] << "\n";
+  }
+}
+
+
+Recording Recording::Load(const std::string &filename)
+{
+  std::ifstream in(filename);
+  if (not in)
+  {
+    throw std::runtime_error("Could not open replay file " + filename);
+  }
+
+  std::string magic;
+  int version = 0;
+  in >> magic >> version;
+  if (magic != "ld40_replay" or version < OLDEST_REPLAY_VERSION or version > REPLAY_VERSION)
+  {
+    throw std::runtime_error("Not a replay file (or wrong version) " + filename);
+  }
+
+  Recording r;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::stringstream ss(line);
+    std::string tag;
+    ss >> tag;
+    if (tag.empty()) continue;
+
+    if (tag == "seeds")
+    {
+      ss >> r.game_seed >> r.factory_seed;
+    }
+    else if (tag == "ticks")
+    {
+      ss >> r.total_ticks;
+    }
+    else if (tag == "scene")
+    {
+      SceneConfig &s = r.scene;
+      ss >> s.num_items >> s.num_monsters >> s.num_projectiles >> s.world_min.x >> s.world_min.y >> s.world_max.x >>
+        s.world_max.y;
+      if (version >= 3) ss >> s.chunk_size;
+    }
+    else if (tag == "k" or tag == "b" or tag == "m")
+    {
+      InputEvent e;
+      ss >> e.tick >> e.a >> e.b;
+      e.type = (tag == "k") ? Input_Type::key : (tag == "b") ? Input_Type::mouse_button : Input_Type::mouse_motion;
+      r.events.push_back(e);
+    }
+    else if (tag == "c")
+    {
+      long tick;
+      uint64_t checksum;
+      ss >> tick >> checksum;
+      r.checksums.push_back(checksum);
+    }
+    else
+    {
+      throw std::runtime_error("Bad line in replay file: " + line);
+    }
+
+    if (ss.fail())
+    {
+      throw std::runtime_error("Bad line in replay file: " + line);
+    }
+  }
+
+  return r;
+}
+
+
+///////////////////////////////////////
+
+
+void InputRecorder::Start(const Game &game)
+{
+  recording = Recording{};
+  recording.game_seed = game.random.GetSeed();
+  recording.factory_seed = game.item_factory.random.GetSeed();
+  recording.scene = game.scene;
+  tick = 0;
+}
+
+
+void InputRecorder::KeyInput(int key, bool down)
+{
+  recording.events.push_back({tick, Input_Type::key, key, down});
+}
+
+
+void InputRecorder::MouseInput(int button, bool down)
+{
+  recording.events.push_back({tick, Input_Type::mouse_button, button, down});
+}
+
+
+void InputRecorder::MouseMotion(int x, int y)
+{
+  recording.events.push_back({tick, Input_Type::mouse_motion, x, y});
+}
+
+
+void InputRecorder::EndTick(const Game &game)
+{
+  tick++;
+  recording.total_ticks = tick;
+
+  if (tick % CHECKSUM_INTERVAL == 0)
+  {
+    recording.checksums.push_back(StateChecksum(game.gamestate));
+  }
+}
+
+
+///////////////////////////////////////
+
+
+ReplayPlayer::ReplayPlayer(const Recording &recording)
+: recording(recording)
+{
+}
+
+
+void ReplayPlayer::Start(Game &game)
+{
+  game.Seed(recording.game_seed, recording.factory_seed);
+  game.scene = recording.scene;
+  game.NewGame();
+
+  next_event = 0;
+  first_mismatch = -1;
+}
+
+
+bool ReplayPlayer::Tick(Game &game, long tick, float dt)
+{
+  if (tick >= recording.total_ticks) return false;
+
+  while (next_event < recording.events.size() and recording.events[next_event].tick <= tick)
+  {
+    const InputEvent &e = recording.events[next_event++];
+    switch (e.type)
+    {
+      case Input_Type::key:
+        game.ProcessKeyInput(e.a, e.b);
+        break;
+      case Input_Type::mouse_button:
+        game.ProcessMouseInput(e.a, e.b);
+        break;
+      case Input_Type::mouse_motion:
+        game.ProcessMouseMotion(e.a, e.b);
+        break;
+    }
+  }
+
+  game.Tick(dt);
+
+  const long ticks_done = tick + 1;
+  if (ticks_done % CHECKSUM_INTERVAL == 0 and first_mismatch < 0)
+  {
+    const unsigned index = ticks_done / CHECKSUM_INTERVAL - 1;
+    if (index < recording.checksums.size() and recording.checksums[index] != StateChecksum(game.gamestate))
+    {
+      first_mismatch = ticks_done;
+    }
+  }
+
+  return true;
+}
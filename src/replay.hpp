@@ -0,0 +1,98 @@
+#pragma once
+
+// Recording and playback of a game session.
+// A recording is the RNG seeds and scene, plus every input tagged with the
+// tick it happened before.  Since the simulation runs on a fixed timestep,
+// feeding the same inputs in at the same ticks gives the same game, so a
+// recording can be replayed headless as fast as the CPU goes.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "game_types.hpp"
+
+
+class Game;
+
+
+// Something that changes if anything in the simulation ends up different
+uint64_t StateChecksum(const GameState &state);
+
+
+enum class Input_Type
+{
+  key,
+  mouse_button,
+  mouse_motion
+};
+
+
+struct InputEvent
+{
+  long tick;
+  Input_Type type;
+  int a; // key, button or x
+  int b; // down or y
+};
+
+
+struct Recording
+{
+  uint32_t game_seed = 0;
+  uint32_t factory_seed = 0;
+  SceneConfig scene;
+  long total_ticks = 0;
+
+  std::vector<InputEvent> events;
+
+  // Checksum of the game state every CHECKSUM_INTERVAL ticks, to find out
+  // when (and if) a replay stops matching the original
+  std::vector<uint64_t> checksums;
+
+  void Save(const std::string &filename) const;
+  static Recording Load(const std::string &filename); //Throws
+};
+
+
+class InputRecorder
+{
+private:
+  Recording recording;
+  long tick = 0;
+
+public:
+  // Call before Game::NewGame(), records the seeds and scene it will use
+  void Start(const Game &game);
+
+  void KeyInput(int key, bool down);
+  void MouseInput(int button, bool down);
+  void MouseMotion(int x, int y);
+
+  // Call after every Game::Tick()
+  void EndTick(const Game &game);
+
+  const Recording &GetRecording() const { return recording; }
+};
+
+
+class ReplayPlayer
+{
+private:
+  const Recording &recording;
+  unsigned next_event = 0;
+  long first_mismatch = -1;
+
+public:
+  explicit ReplayPlayer(const Recording &recording);
+
+  // Seeds the game and starts a new one
+  void Start(Game &game);
+
+  // Feeds in the recorded input for a tick, then runs it.
+  // Returns false once the recording has run out.
+  bool Tick(Game &game, long tick, float dt);
+
+  // -1 if every checksum so far has matched
+  long FirstMismatch() const { return first_mismatch; }
+};
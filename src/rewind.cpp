@@ -0,0 +1,279 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "snapshot.hpp"
+
+// A run of unchanged bytes shorter than this is cheaper to copy than to skip
+constexpr size_t MIN_ZERO_RUN{4};
+
+
+namespace
+{
+
+void WriteVarint(std::vector<uint8_t> &out, uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    out.push_back(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(uint8_t(v));
+}
+
+
+uint64_t ReadVarint(const uint8_t *&in, const uint8_t *end)
+{
+  uint64_t v = 0;
+  for (int shift = 0; in < end and shift < 64; shift += 7)
+  {
+    const uint8_t byte = *in++;
+    v |= uint64_t(byte & 0x7f) << shift;
+    if (not(byte & 0x80)) return v;
+  }
+  throw std::runtime_error("Corrupt rewind frame");
+}
+
+
+// As (unchanged count, changed count, changed bytes) runs.
+// Bytes past the end of the old span count as zero.
+void EncodeSpan(const uint8_t *old, size_t old_size, const uint8_t *now, size_t size,
+                std::vector<uint8_t> &scratch, std::vector<uint8_t> &out)
+{
+  scratch.resize(size);
+  uint8_t *x = scratch.data();
+
+  const size_t common = std::min(old_size, size);
+  for (size_t i = 0; i < common; i++) x[i] = old[i] ^ now[i];
+  if (size > common) std::memcpy(x + common, now + common, size - common);
+
+  size_t i = 0;
+  while (i < size)
+  {
+    const size_t zeros_start = i;
+    while (i + 8 <= size)
+    {
+      uint64_t word;
+      std::memcpy(&word, x + i, 8);
+      if (word != 0) break;
+      i += 8;
+    }
+    while (i < size and x[i] == 0) i++;
+    const size_t zeros = i - zeros_start;
+
+    // Carry on through short gaps of unchanged bytes
+    const size_t literal_start = i;
+    size_t gap = 0;
+    for (; i < size and gap < MIN_ZERO_RUN; i++)
+    {
+      gap = (x[i] == 0) ? gap + 1 : 0;
+    }
+    const size_t literal_end = i - gap;
+    i = literal_end;
+
+    WriteVarint(out, zeros);
+    WriteVarint(out, literal_end - literal_start);
+    out.insert(out.end(), x + literal_start, x + literal_end);
+  }
+}
+
+
+void DecodeSpan(const uint8_t *old, size_t old_size, uint8_t *now, size_t size, const uint8_t *&in, const uint8_t *end)
+{
+  size_t i = 0;
+  while (i < size)
+  {
+    const size_t zeros = ReadVarint(in, end);
+    const size_t literal = ReadVarint(in, end);
+    if (zeros + literal > size - i or literal > size_t(end - in))
+    {
+      throw std::runtime_error("Corrupt rewind frame");
+    }
+
+    for (size_t stop = i + zeros; i < stop; i++)
+    {
+      now[i] = (i < old_size) ? old[i] : 0;
+    }
+    for (size_t stop = i + literal; i < stop; i++)
+    {
+      now[i] = ((i < old_size) ? old[i] : 0) ^ *in++;
+    }
+  }
+}
+
+
+// Delta is the new size and layout, then each span against the same span in old
+std::vector<uint8_t> EncodeDelta(const std::vector<char> &old, const std::vector<char> &now)
+{
+  const std::vector<SnapshotSpan> old_spans = SnapshotLayout(old.data(), old.size());
+  const std::vector<SnapshotSpan> spans = SnapshotLayout(now.data(), now.size());
+  assert(old_spans.size() == spans.size());
+
+  std::vector<uint8_t> out;
+  WriteVarint(out, now.size());
+  for (auto &span : spans)
+  {
+    WriteVarint(out, span.offset);
+    WriteVarint(out, span.size);
+  }
+
+  std::vector<uint8_t> scratch;
+  const uint8_t *old_data = reinterpret_cast<const uint8_t *>(old.data());
+  const uint8_t *now_data = reinterpret_cast<const uint8_t *>(now.data());
+  for (unsigned s = 0; s < spans.size(); s++)
+  {
+    EncodeSpan(old_data + old_spans[s].offset, old_spans[s].size, now_data + spans[s].offset, spans[s].size, scratch, out);
+  }
+
+  out.shrink_to_fit();
+  return out;
+}
+
+
+void DecodeDelta(const std::vector<char> &old, const std::vector<uint8_t> &delta, std::vector<char> &now)
+{
+  const std::vector<SnapshotSpan> old_spans = SnapshotLayout(old.data(), old.size());
+
+  const uint8_t *in = delta.data();
+  const uint8_t *end = delta.data() + delta.size();
+
+  const size_t size = ReadVarint(in, end);
+  std::vector<SnapshotSpan> spans(old_spans.size());
+  for (auto &span : spans)
+  {
+    span.offset = ReadVarint(in, end);
+    span.size = ReadVarint(in, end);
+    if (span.offset > size or span.size > size - span.offset)
+    {
+      throw std::runtime_error("Corrupt rewind frame");
+    }
+  }
+
+  // Anything not in a span is alignment padding, which is always zero
+  now.assign(size, 0);
+
+  const uint8_t *old_data = reinterpret_cast<const uint8_t *>(old.data());
+  uint8_t *now_data = reinterpret_cast<uint8_t *>(now.data());
+  for (unsigned s = 0; s < spans.size(); s++)
+  {
+    DecodeSpan(old_data + old_spans[s].offset, old_spans[s].size, now_data + spans[s].offset, spans[s].size, in, end);
+  }
+}
+
+} // namespace
+
+
+///////////////////////////////////////
+
+
+RewindBuffer::RewindBuffer(int capacity_ticks, int keyframe_interval)
+: capacity(std::max(capacity_ticks, 1))
+, keyframe_interval(std::max(keyframe_interval, 1))
+{
+}
+
+
+void RewindBuffer::PushFrame(Frame frame)
+{
+  memory_used += frame.data.capacity();
+  frames.push_back(std::move(frame));
+
+  // Only ever drop a whole keyframe and its deltas, as they need it
+  while (int(frames.size()) > capacity + keyframe_interval)
+  {
+    do
+    {
+      memory_used -= frames.front().data.capacity();
+      frames.pop_front();
+    } while (not frames.empty() and not frames.front().keyframe);
+  }
+}
+
+
+void RewindBuffer::Record(long tick, const GameState &state)
+{
+  assert(frames.empty() or tick == frames.back().tick + 1);
+
+  std::vector<char> snapshot = WriteSnapshot(state);
+
+  if (frames.empty() or ticks_since_keyframe + 1 >= keyframe_interval)
+  {
+    PushFrame({tick, true, std::vector<uint8_t>(snapshot.begin(), snapshot.end())});
+    ticks_since_keyframe = 0;
+  }
+  else
+  {
+    PushFrame({tick, false, EncodeDelta(last_snapshot, snapshot)});
+    ticks_since_keyframe++;
+  }
+
+  last_snapshot = std::move(snapshot);
+}
+
+
+bool RewindBuffer::Rebuild(long tick, std::vector<char> &snapshot) const
+{
+  if (frames.empty() or tick < OldestTick() or tick > NewestTick()) return false;
+
+  int index = int(tick - OldestTick());
+  int key = index;
+  while (not frames[key].keyframe) key--;
+
+  snapshot.assign(frames[key].data.begin(), frames[key].data.end());
+
+  std::vector<char> next;
+  for (int i = key + 1; i <= index; i++)
+  {
+    DecodeDelta(snapshot, frames[i].data, next);
+    snapshot.swap(next);
+  }
+
+  return true;
+}
+
+
+bool RewindBuffer::Restore(long tick, GameState &state) const
+{
+  std::vector<char> snapshot;
+  if (not Rebuild(tick, snapshot)) return false;
+
+  ReadSnapshot(snapshot.data(), snapshot.size(), state);
+  return true;
+}
+
+
+void RewindBuffer::Truncate(long tick)
+{
+  if (frames.empty() or tick >= NewestTick()) return;
+  if (tick < OldestTick())
+  {
+    clear();
+    return;
+  }
+
+  Rebuild(tick, last_snapshot);
+
+  while (frames.back().tick > tick)
+  {
+    memory_used -= frames.back().data.capacity();
+    frames.pop_back();
+  }
+
+  ticks_since_keyframe = 0;
+  for (int i = int(frames.size()) - 1; not frames[i].keyframe; i--)
+  {
+    ticks_since_keyframe++;
+  }
+}
+
+
+void RewindBuffer::clear()
+{
+  frames.clear();
+  last_snapshot.clear();
+  memory_used = 0;
+  ticks_since_keyframe = 0;
+}
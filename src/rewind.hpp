@@ -0,0 +1,66 @@
+#pragma once
+
+// History of the last few seconds of GameState, for stepping back and
+// re-simulating forwards.
+//
+// Every tick is stored as a snapshot (see snapshot.hpp).  Every
+// keyframe_interval ticks the whole snapshot is kept; in between only the
+// XOR with the tick before, array by array, with the runs of unchanged bytes
+// squeezed out and the lengths stored as varints.  Getting a tick back means
+// decoding forward from the keyframe before it.
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "game_types.hpp"
+
+
+class RewindBuffer
+{
+private:
+  struct Frame
+  {
+    long tick;
+    bool keyframe;
+    std::vector<uint8_t> data;
+  };
+
+  int capacity;
+  int keyframe_interval;
+  int ticks_since_keyframe = 0;
+
+  std::deque<Frame> frames;
+  size_t memory_used = 0;
+
+  // Snapshot of the newest tick, the next delta is against this
+  std::vector<char> last_snapshot;
+
+  void PushFrame(Frame frame);
+  bool Rebuild(long tick, std::vector<char> &snapshot) const;
+
+public:
+  // Keeps at least capacity_ticks of history
+  explicit RewindBuffer(int capacity_ticks, int keyframe_interval = 60);
+
+  // Call after every tick
+  void Record(long tick, const GameState &state);
+
+  // Puts state back how it was after tick.  Returns false if the tick is not
+  // in the buffer any more (or yet).
+  bool Restore(long tick, GameState &state) const;
+
+  // Forgets everything after tick, so the game can carry on from there
+  void Truncate(long tick);
+
+  void clear();
+
+  bool empty() const { return frames.empty(); }
+  long OldestTick() const { return frames.empty() ? -1 : frames.front().tick; }
+  long NewestTick() const { return frames.empty() ? -1 : frames.back().tick; }
+  int Ticks() const { return int(frames.size()); }
+
+  // Bytes held for all the frames
+  size_t MemoryUsed() const { return memory_used; }
+};
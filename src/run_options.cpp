@@ -0,0 +1,175 @@
+#include "run_options.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+#include "game.hpp"
+
+
+const char *RUN_OPTIONS_USAGE =
+  "  --items N           items to start with\n"
+  "  --monsters N        monsters to start with\n"
+  "  --projectiles N     stray projectiles to start with\n"
+  "  --world WxH         size of the area things start in\n"
+  "  --chunks SIZE       endless world streamed in SIZE pixel chunks, with\n"
+  "                      the items and monsters counts per chunk\n"
+  "  --seed N            same game every time\n"
+  "  --seconds S         quit after S seconds of game time\n"
+  "  --bench-frames N    quit after N frames, and print frame and tick times\n"
+  "  --record FILE       save the session for ld40_sim --replay\n";
+
+
+namespace
+{
+
+// Up to max, which is as big as an int unless given
+long long ParseCount(const std::string &option, const std::string &value, long long max = INT_MAX)
+{
+  size_t used = 0;
+  long long n = -1;
+  try
+  {
+    n = std::stoll(value, &used);
+  }
+  catch (std::exception &)
+  {
+  }
+
+  if (used != value.size() or n < 0 or n > max)
+  {
+    throw std::runtime_error("Expected a count for " + option + ", got '" + value + "'");
+  }
+  return n;
+}
+
+
+float ParseSeconds(const std::string &option, const std::string &value)
+{
+  size_t used = 0;
+  float f = -1.0f;
+  try
+  {
+    f = std::stof(value, &used);
+  }
+  catch (std::exception &)
+  {
+  }
+
+  if (used != value.size() or not(f >= 0.0f))
+  {
+    throw std::runtime_error("Expected seconds for " + option + ", got '" + value + "'");
+  }
+  return f;
+}
+
+} // namespace
+
+
+RunOptions ParseRunOptions(const std::vector<std::string> &args)
+{
+  RunOptions options;
+
+  for (size_t i = 0; i < args.size(); i++)
+  {
+    const std::string &option = args[i];
+    if (i + 1 >= args.size())
+    {
+      throw std::runtime_error("Unknown option, or missing value: " + option);
+    }
+    const std::string &value = args[++i];
+
+    if (option == "--items")
+    {
+      options.scene.num_items = int(ParseCount(option, value));
+    }
+    else if (option == "--monsters")
+    {
+      options.scene.num_monsters = int(ParseCount(option, value));
+    }
+    else if (option == "--projectiles")
+    {
+      options.scene.num_projectiles = int(ParseCount(option, value));
+    }
+    else if (option == "--world")
+    {
+      const size_t x = value.find('x');
+      if (x == std::string::npos)
+      {
+        throw std::runtime_error("Expected WxH for --world, got '" + value + "'");
+      }
+      options.scene.world_min = {0.0f, 0.0f};
+      options.scene.world_max = {float(ParseCount(option, value.substr(0, x))),
+                                 float(ParseCount(option, value.substr(x + 1)))};
+    }
+    else if (option == "--chunks")
+    {
+      options.scene.chunk_size = float(ParseCount(option, value));
+    }
+    else if (option == "--seed")
+    {
+      options.seeded = true;
+      options.seed = uint32_t(ParseCount(option, value, UINT32_MAX));
+    }
+    else if (option == "--seconds")
+    {
+      options.seconds = ParseSeconds(option, value);
+    }
+    else if (option == "--bench-frames")
+    {
+      options.bench_frames = ParseCount(option, value);
+    }
+    else if (option == "--record")
+    {
+      options.record_file = value;
+    }
+    else
+    {
+      throw std::runtime_error("Unknown option " + option);
+    }
+  }
+
+  return options;
+}
+
+
+void ApplyRunOptions(const RunOptions &options, Game &game)
+{
+  game.scene = options.scene;
+  if (options.seeded) game.Seed(options.seed, options.seed + 1);
+}
+
+
+///////////////////////////////////////
+
+
+double TimingStats::Mean() const
+{
+  if (samples.empty()) return 0.0;
+  return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+
+double TimingStats::Percentile(double percent) const
+{
+  if (samples.empty()) return 0.0;
+
+  std::vector<double> sorted = samples;
+  const size_t rank = size_t(std::ceil(percent / 100.0 * sorted.size()));
+  const size_t index = std::min(std::max(rank, size_t(1)), sorted.size()) - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+  return sorted[index];
+}
+
+
+void TimingStats::Print(std::ostream &out, const std::string &name) const
+{
+  out << name << " over " << size() << ":  mean " << Mean() << "ms"
+      << "  p50 " << Percentile(50.0) << "ms"
+      << "  p90 " << Percentile(90.0) << "ms"
+      << "  p99 " << Percentile(99.0) << "ms"
+      << "  max " << Percentile(100.0) << "ms" << std::endl;
+}
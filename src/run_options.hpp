@@ -0,0 +1,63 @@
+#pragma once
+
+// Command line options shared by the game and the headless driver, for
+// setting up bigger scenes and timing how they run.
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "game_types.hpp"
+
+
+class Game;
+
+
+struct RunOptions
+{
+  SceneConfig scene;
+
+  // Otherwise the seeds come from the clock
+  bool seeded = false;
+  uint32_t seed = 0;
+
+  // Game seconds to run for, 0 is until quit
+  float seconds = 0.0f;
+
+  // Quit after this many frames and print how long they took, 0 is off
+  long bench_frames = 0;
+
+  std::string record_file;
+};
+
+
+extern const char *RUN_OPTIONS_USAGE;
+
+// Reads the options listed in RUN_OPTIONS_USAGE
+RunOptions ParseRunOptions(const std::vector<std::string> &args); //Throws
+
+// Call before Game::NewGame()
+void ApplyRunOptions(const RunOptions &options, Game &game);
+
+
+// Frame or tick times, for averages and percentiles
+class TimingStats
+{
+private:
+  std::vector<double> samples;
+
+public:
+  void reserve(size_t count) { samples.reserve(count); }
+  int size() const { return int(samples.size()); }
+
+  void Add(double ms) { samples.push_back(ms); }
+
+  double Mean() const;
+
+  // Nearest rank, percent from 0 to 100
+  double Percentile(double percent) const;
+
+  // One line: count, mean, p50, p90, p99 and max
+  void Print(std::ostream &out, const std::string &name) const;
+};
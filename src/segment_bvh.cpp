@@ -0,0 +1,162 @@
+#include "segment_bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "collision.hpp"
+#include "maths.hpp"
+
+
+void SegmentBVH::clear()
+{
+  segments.clear();
+  nodes.clear();
+}
+
+
+void SegmentBVH::Build(std::vector<Segment> new_segments)
+{
+  segments = std::move(new_segments);
+  nodes.clear();
+  if (segments.empty()) return;
+
+  nodes.reserve(2 * segments.size() / LEAF_SIZE + 1);
+  nodes.push_back({});
+  Build(0, 0, int(segments.size()));
+}
+
+
+// Fills in nodes[node] for segments begin to end, splitting them in half
+// across the middle of whichever way their centres are spread out more
+void SegmentBVH::Build(int node, int begin, int end)
+{
+  vec2 min = segments[begin].a;
+  vec2 max = min;
+  vec2 centre_min{segments[begin].a.x + segments[begin].b.x, segments[begin].a.y + segments[begin].b.y};
+  vec2 centre_max = centre_min;
+
+  for (int i = begin; i < end; i++)
+  {
+    const Segment& s = segments[i];
+    min.x = std::min({min.x, s.a.x, s.b.x});
+    min.y = std::min({min.y, s.a.y, s.b.y});
+    max.x = std::max({max.x, s.a.x, s.b.x});
+    max.y = std::max({max.y, s.a.y, s.b.y});
+
+    // Centres times two, only the order matters
+    const vec2 centre{s.a.x + s.b.x, s.a.y + s.b.y};
+    centre_min.x = std::min(centre_min.x, centre.x);
+    centre_min.y = std::min(centre_min.y, centre.y);
+    centre_max.x = std::max(centre_max.x, centre.x);
+    centre_max.y = std::max(centre_max.y, centre.y);
+  }
+
+  nodes[node].min = min;
+  nodes[node].max = max;
+
+  if (end - begin <= LEAF_SIZE)
+  {
+    nodes[node].first = begin;
+    nodes[node].count = end - begin;
+    return;
+  }
+
+  const bool split_y = (centre_max.y - centre_min.y) > (centre_max.x - centre_min.x);
+  const int middle = (begin + end) / 2;
+  std::nth_element(segments.begin() + begin, segments.begin() + middle, segments.begin() + end,
+    [&](const Segment& s1, const Segment& s2) {
+      return split_y ? (s1.a.y + s1.b.y) < (s2.a.y + s2.b.y) : (s1.a.x + s1.b.x) < (s2.a.x + s2.b.x);
+    });
+
+  const int children = int(nodes.size());
+  nodes.push_back({});
+  nodes.push_back({});
+  nodes[node].first = children;
+  nodes[node].count = 0;
+
+  Build(children, begin, middle);
+  Build(children + 1, middle, end);
+}
+
+
+float SegmentBVH::SegmentDistanceSquared(const Segment& segment, vec2 position)
+{
+  return distance_squared(position, nearest_point_on_line_segment(segment.a, segment.b, position));
+}
+
+
+vec2 SegmentBVH::PushOut(vec2 position, float radius) const
+{
+  QueryCircle(position, radius, [&](int index) {
+    const Segment& s = segments[index];
+    const vec2 nearest = nearest_point_on_line_segment(s.a, s.b, position);
+    const vec2 offset = position - nearest;
+    const float d = get_length(offset);
+
+    // Exactly on the line, so out the left hand side
+    if (d == 0.0f)
+    {
+      position += normalize(vec2{s.a.y - s.b.y, s.b.x - s.a.x}) * radius;
+      return;
+    }
+
+    // Touching the segment pushed out by an earlier one may not touch any more
+    if (d < radius) position += offset * ((radius - d) / d);
+  });
+
+  return position;
+}
+
+
+// Time of impact against the sides of the capsule around the segment, and
+// against its rounded ends
+float SegmentBVH::SegmentSweepTime(const Segment& s, vec2 start, vec2 stop, float radius)
+{
+  // Already touching
+  if (SegmentDistanceSquared(s, start) <= radius * radius) return 0.0f;
+
+  float first = -1.0f;
+  auto take = [&](float t) {
+    if (t >= 0.0f and (first < 0.0f or t < first)) first = t;
+  };
+
+  const vec2 along = s.b - s.a;
+  const float length = get_length(along);
+  if (length > 0.0f)
+  {
+    const vec2 normal{-along.y / length, along.x / length};
+    const float d0 = dot(start - s.a, normal);
+    const float d1 = dot(stop - s.a, normal);
+
+    // Crossing into the side it starts on
+    const float side = d0 >= 0.0f ? radius : -radius;
+    if (std::abs(d0) > radius and (d0 - side) * (d1 - side) <= 0.0f)
+    {
+      const float t = (d0 - side) / (d0 - d1);
+      const vec2 hit = start + (stop - start) * t;
+      const float u = dot(hit - s.a, along) / (length * length);
+      if (u >= 0.0f and u <= 1.0f) take(t);
+    }
+  }
+
+  take(SweptCircleTime(start, stop, radius, s.a, 0.0f));
+  take(SweptCircleTime(start, stop, radius, s.b, 0.0f));
+
+  return first;
+}
+
+
+float SegmentBVH::SweepTime(vec2 start, vec2 stop, float radius) const
+{
+  const vec2 min{std::min(start.x, stop.x) - radius, std::min(start.y, stop.y) - radius};
+  const vec2 max{std::max(start.x, stop.x) + radius, std::max(start.y, stop.y) + radius};
+
+  float first = -1.0f;
+  QueryBox(min, max, [&](int index) {
+    const float t = SegmentSweepTime(segments[index], start, stop, radius);
+    if (t >= 0.0f and (first < 0.0f or t < first)) first = t;
+  });
+
+  return first;
+}
+
@@ -0,0 +1,99 @@
+#pragma once
+
+// Bounding volume hierarchy over line segments, for walls that never move.
+// Built once per level, then circles are tested against whatever segments
+// are near them, without looking at the rest.
+
+#include <vector>
+
+#include "maths_types.hpp"
+
+
+struct Segment
+{
+  vec2 a;
+  vec2 b;
+};
+
+
+class SegmentBVH
+{
+private:
+  static constexpr int LEAF_SIZE = 4;
+
+  struct Node
+  {
+    vec2 min;
+    vec2 max;
+
+    // Leaves have count segments from first, others have their children at first and first + 1
+    int first;
+    int count;
+  };
+
+  std::vector<Segment> segments;
+  std::vector<Node> nodes;
+
+  void Build(int node, int begin, int end);
+
+public:
+  void Build(std::vector<Segment> new_segments);
+  void clear();
+
+  int size() const { return int(segments.size()); }
+  const Segment& operator[](int index) const { return segments[index]; }
+
+  // Calls func(index) for every segment within radius of position
+  template<typename FUNC>
+  void QueryCircle(vec2 position, float radius, FUNC&& func) const
+  {
+    QueryBox({position.x - radius, position.y - radius}, {position.x + radius, position.y + radius}, [&](int index) {
+      if (SegmentDistanceSquared(segments[index], position) <= radius * radius) func(index);
+    });
+  }
+
+  // Calls func(index) for every segment whose bounding box touches min to max
+  template<typename FUNC>
+  void QueryBox(vec2 min, vec2 max, FUNC&& func) const
+  {
+    if (nodes.empty()) return;
+
+    // Deep enough for 2^64 leaves
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+      const Node& node = nodes[stack[--top]];
+      if (node.max.x < min.x or node.min.x > max.x or node.max.y < min.y or node.min.y > max.y) continue;
+
+      if (node.count > 0)
+      {
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+          func(i);
+        }
+      }
+      else
+      {
+        stack[top++] = node.first;
+        stack[top++] = node.first + 1;
+      }
+    }
+  }
+
+  static float SegmentDistanceSquared(const Segment& segment, vec2 position);
+
+  // SweepTime against just the one segment
+  static float SegmentSweepTime(const Segment& segment, vec2 start, vec2 stop, float radius);
+
+  // Where to move a circle so it no longer overlaps any segment.  Pushes out
+  // of each one it touches, which is exact for one wall and close enough for
+  // corners.
+  vec2 PushOut(vec2 position, float radius) const;
+
+  // How far a circle moving from start to stop gets before it first touches a
+  // segment, as a fraction of the way.  Negative if it never does.
+  float SweepTime(vec2 start, vec2 stop, float radius) const;
+};
@@ -0,0 +1,325 @@
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Headless driver for the simulation.  Runs the game with scripted input,
+// without creating a window, GL context or audio device.
+
+constexpr long DEFAULT_TICKS{10000};
+constexpr float TICK_LENGTH{1.0f / 120.0f};
+
+
+#include <SDL.h>
+#undef main
+
+
+#include "game.hpp"
+#include "maths.hpp"
+#include "replay.hpp"
+#include "run_options.hpp"
+#include "to_string.hpp"
+
+
+// Plays the game by pressing keys the same way a player would: walk to an
+// item, bind it to a spare key, and keep firing everything bound.
+class ScriptedInput
+{
+private:
+  std::vector<int> spare_keys{
+    SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4, SDL_SCANCODE_5, SDL_SCANCODE_6, SDL_SCANCODE_7, SDL_SCANCODE_8, SDL_SCANCODE_9,
+    SDL_SCANCODE_E, SDL_SCANCODE_F, SDL_SCANCODE_G, SDL_SCANCODE_H, SDL_SCANCODE_I, SDL_SCANCODE_J, SDL_SCANCODE_K, SDL_SCANCODE_L, SDL_SCANCODE_M,
+    SDL_SCANCODE_N, SDL_SCANCODE_O, SDL_SCANCODE_P, SDL_SCANCODE_Q, SDL_SCANCODE_R, SDL_SCANCODE_T, SDL_SCANCODE_U, SDL_SCANCODE_V, SDL_SCANCODE_X};
+
+  std::vector<int> held_keys;
+
+  InputRecorder *recorder = nullptr;
+
+  void Key(Game &game, int key, bool down)
+  {
+    game.ProcessKeyInput(key, down);
+    if (recorder) recorder->KeyInput(key, down);
+  }
+
+  void Press(Game &game, int key)
+  {
+    Key(game, key, true);
+    held_keys.push_back(key);
+  }
+
+  void ReleaseAll(Game &game)
+  {
+    for (int key : held_keys)
+    {
+      Key(game, key, false);
+    }
+    held_keys.clear();
+  }
+
+  void Walk(Game &game, vec2 target)
+  {
+    const vec2 diff = target - game.gamestate.player.position;
+    constexpr float close_enough = 10.0f;
+
+    if (diff.x > close_enough) Press(game, SDL_SCANCODE_D);
+    if (diff.x < -close_enough) Press(game, SDL_SCANCODE_A);
+    if (diff.y > close_enough) Press(game, SDL_SCANCODE_S);
+    if (diff.y < -close_enough) Press(game, SDL_SCANCODE_W);
+  }
+
+public:
+  // Everything pressed from now on also goes to the recorder
+  void RecordTo(InputRecorder *input_recorder) { recorder = input_recorder; }
+
+  void Apply(Game &game, long tick)
+  {
+    ReleaseAll(game);
+
+    GameState &state = game.gamestate;
+
+    if (not state.world_monsters.empty())
+    {
+      const vec2 target = state.world_monsters[0].position;
+      game.ProcessMouseMotion(int(target.x), int(target.y));
+      if (recorder) recorder->MouseMotion(int(target.x), int(target.y));
+    }
+
+    if (state.world_items.Contains(state.closest_item) and not spare_keys.empty())
+    {
+      Press(game, spare_keys.back());
+      spare_keys.pop_back();
+      return;
+    }
+
+    if (not state.world_items.empty())
+    {
+      Walk(game, state.world_items[0].position);
+    }
+
+    if (tick % 10 == 0)
+    {
+      for (auto &binding : state.player.KeyBindInventory)
+      {
+        if (binding.item.type != Item_Type::command) Press(game, binding.key);
+      }
+    }
+  }
+};
+
+
+void bench_broadphase();
+void bench_chunks();
+void bench_crowd();
+void bench_flowfield();
+void bench_items();
+void bench_keybinds();
+void bench_lod();
+void bench_overlap();
+void bench_physics();
+void bench_pool();
+void bench_projectiles();
+void bench_rewind();
+void bench_sight();
+void bench_snapshot();
+void bench_threads();
+void bench_timers();
+void bench_tunnel();
+void bench_walls();
+
+
+const std::map<std::string, void (*)()> BENCHMARKS{
+  {"broadphase", bench_broadphase},
+  {"chunks", bench_chunks},
+  {"crowd", bench_crowd},
+  {"flowfield", bench_flowfield},
+  {"items", bench_items},
+  {"keybinds", bench_keybinds},
+  {"lod", bench_lod},
+  {"overlap", bench_overlap},
+  {"physics", bench_physics},
+  {"pool", bench_pool},
+  {"projectiles", bench_projectiles},
+  {"rewind", bench_rewind},
+  {"sight", bench_sight},
+  {"snapshot", bench_snapshot},
+  {"threads", bench_threads},
+  {"timers", bench_timers},
+  {"tunnel", bench_tunnel},
+  {"walls", bench_walls}};
+
+
+int run_benchmark(const std::string &name)
+{
+  auto it = BENCHMARKS.find(name);
+  if (it == BENCHMARKS.end())
+  {
+    std::cout << "Unknown benchmark '" << name << "', try one of:";
+    for (auto &bench : BENCHMARKS) std::cout << " " << bench.first;
+    std::cout << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  SetStreamFormat(std::cout);
+  std::cout.precision(3);
+
+  it->second();
+  return EXIT_SUCCESS;
+}
+
+
+// Runs a recording as fast as possible, checking it still plays out the same
+int run_replay(const std::string &filename)
+{
+  Recording recording;
+  try
+  {
+    recording = Recording::Load(filename);
+  }
+  catch (std::exception &e)
+  {
+    std::cout << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Game game;
+  ReplayPlayer player(recording);
+  player.Start(game);
+
+  auto time_start = std::chrono::steady_clock::now();
+
+  long tick = 0;
+  while (game.gamestate.running and player.Tick(game, tick, TICK_LENGTH))
+  {
+    tick++;
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - time_start;
+
+  SetStreamFormat(std::cout);
+  std::cout.precision(3);
+  std::cout << "Replayed " << tick << " of " << recording.total_ticks << " ticks in " << elapsed.count() << "s  ("
+            << (tick / elapsed.count()) << " ticks/second)" << std::endl;
+  std::cout << "Final checksum: " << std::hex << StateChecksum(game.gamestate) << std::dec << std::endl;
+
+  if (player.FirstMismatch() >= 0)
+  {
+    std::cout << "Replay DIVERGED from the recording by tick " << player.FirstMismatch() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Matched all " << recording.checksums.size() << " recorded checksums" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char *argv[])
+{
+  std::cout << "CPP version: " << CPPVersion() << std::endl;
+
+  if (argc > 2 and std::string(argv[1]) == "--bench")
+  {
+    return run_benchmark(argv[2]);
+  }
+
+  if (argc > 2 and std::string(argv[1]) == "--replay")
+  {
+    return run_replay(argv[2]);
+  }
+
+  // "[--record <file>] [ticks] [options]", each frame is one tick here
+  std::vector<std::string> args(argv + 1, argv + argc);
+  long num_ticks = DEFAULT_TICKS;
+
+  const size_t ticks_arg = (args.size() > 1 and args[0] == "--record") ? 2 : 0;
+  if (args.size() > ticks_arg and std::isdigit((unsigned char)args[ticks_arg][0]))
+  {
+    num_ticks = std::stol(args[ticks_arg]);
+    args.erase(args.begin() + ticks_arg);
+  }
+
+  RunOptions options;
+  try
+  {
+    options = ParseRunOptions(args);
+  }
+  catch (std::exception &e)
+  {
+    std::cout << e.what() << "\n\nUsage: ld40_sim [ticks] [options]\n"
+              << "       ld40_sim --replay FILE\n"
+              << "       ld40_sim --bench NAME\n\n"
+              << RUN_OPTIONS_USAGE;
+    return EXIT_FAILURE;
+  }
+
+  if (options.seconds > 0.0f) num_ticks = long(std::ceil(options.seconds / TICK_LENGTH));
+  if (options.bench_frames > 0) num_ticks = options.bench_frames;
+
+  const std::string &record_file = options.record_file;
+
+  Game game;
+  ApplyRunOptions(options, game);
+
+  InputRecorder recorder;
+  ScriptedInput input;
+  if (not record_file.empty())
+  {
+    recorder.Start(game);
+    input.RecordTo(&recorder);
+  }
+
+  game.NewGame();
+
+  TimingStats tick_times;
+  if (options.bench_frames > 0) tick_times.reserve(num_ticks);
+
+  auto time_start = std::chrono::steady_clock::now();
+
+  long tick = 0;
+  for (; tick < num_ticks and game.gamestate.running; tick++)
+  {
+    auto tick_start = std::chrono::steady_clock::now();
+
+    input.Apply(game, tick);
+    game.Tick(TICK_LENGTH);
+    if (not record_file.empty()) recorder.EndTick(game);
+
+    if (options.bench_frames > 0)
+    {
+      std::chrono::duration<double, std::milli> tick_time = std::chrono::steady_clock::now() - tick_start;
+      tick_times.Add(tick_time.count());
+    }
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - time_start;
+
+  SetStreamFormat(std::cout);
+  std::cout.precision(3);
+  std::cout << "Simulated " << tick << " ticks in " << elapsed.count() << "s  ("
+            << (tick / elapsed.count()) << " ticks/second)" << std::endl;
+  if (options.bench_frames > 0) tick_times.Print(std::cout, "Tick times");
+
+  std::cout << "Items left: " << game.gamestate.world_items.size()
+            << "   Monsters left: " << game.gamestate.world_monsters.size()
+            << "   Projectiles: " << game.gamestate.world_projectiles.size()
+            << std::endl;
+
+  const ProjectileStore &projectiles = game.gamestate.world_projectiles;
+  const ProjectileStore::Counters &pool = projectiles.GetCounters();
+  std::cout << "Projectile pool: peak " << pool.peak << " of " << projectiles.Capacity()
+            << "   spawned " << pool.spawned << "   dropped " << pool.dropped
+            << "   refused " << pool.refused << std::endl;
+
+  std::cout << "Final checksum: " << std::hex << StateChecksum(game.gamestate) << std::dec << std::endl;
+
+  if (not record_file.empty())
+  {
+    recorder.GetRecording().Save(record_file);
+    std::cout << "Saved replay to " << record_file << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
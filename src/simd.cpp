@@ -0,0 +1,43 @@
+#include "simd.hpp"
+
+
+SimdLevel DetectSimdLevel()
+{
+#if SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::avx2;
+  if (__builtin_cpu_supports("sse2")) return SimdLevel::sse2;
+#endif
+  return SimdLevel::scalar;
+}
+
+
+static const SimdLevel cpu_simd_level = DetectSimdLevel();
+static SimdLevel simd_level = cpu_simd_level;
+
+
+SimdLevel GetSimdLevel()
+{
+  return simd_level;
+}
+
+
+void ForceSimdLevel(SimdLevel level)
+{
+  simd_level = (level > cpu_simd_level) ? cpu_simd_level : level;
+}
+
+
+const char *GetSimdLevelName(SimdLevel level)
+{
+  switch (level)
+  {
+    case SimdLevel::scalar:
+      return "scalar";
+    case SimdLevel::sse2:
+      return "SSE2";
+    case SimdLevel::avx2:
+      return "AVX2";
+  }
+  return "unknown";
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Runtime selection of SIMD kernels.
+// Kernels are compiled for each instruction set with target attributes,
+// and the best one the CPU supports is picked when they are called.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+#if SIMD_X86
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+enum class SimdLevel
+{
+  scalar,
+  sse2,
+  avx2
+};
+
+
+SimdLevel GetSimdLevel();
+
+// Mostly for benchmarks, levels above what the CPU supports are ignored
+void ForceSimdLevel(SimdLevel level);
+
+const char *GetSimdLevelName(SimdLevel level);
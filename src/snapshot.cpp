@@ -0,0 +1,690 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <stdexcept>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr char SNAPSHOT_MAGIC[8] = {'L', 'D', '4', '0', 'S', 'N', 'A', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION{7};
+constexpr uint32_t SNAPSHOT_ENDIAN_CHECK{0x01020304};
+
+// Every section starts on this boundary, so records can be used in place
+constexpr size_t SNAPSHOT_ALIGN{16};
+
+
+namespace
+{
+
+// Everything below is the file format, so only fixed size types
+struct StringRef
+{
+  uint32_t offset;
+  uint32_t length;
+};
+
+
+struct Section
+{
+  uint64_t offset;
+  uint64_t count;
+};
+
+
+struct ItemRecord
+{
+  int32_t type;
+  int32_t command;
+  float x, y;
+  float vx, vy;
+  float radius;
+  uint8_t colour[4];
+  uint8_t colliding;
+  uint8_t has_cooldown;
+  uint8_t has_limited_uses;
+  uint8_t awake;
+  float cooldown_ready;
+  float cooldown_max;
+  int32_t uses_left;
+  int32_t uses_max;
+  int32_t count;
+  int32_t healing_amount;
+  int32_t projectile_damage;
+  float animation_offset;
+  StringRef name;
+  StringRef animation;
+};
+
+
+struct BindingRecord
+{
+  int32_t key;
+  int32_t padding;
+  ItemRecord item;
+};
+
+
+struct MonsterRecord
+{
+  int32_t type;
+  float x, y;
+  float last_x, last_y;
+  float vx, vy;
+  float radius;
+  int32_t health;
+  int32_t health_max;
+  float fire_ready;
+  float moved_at;
+  float step_dt;
+  StringRef name;
+};
+
+
+// A monster still to appear, due is in timer wheel ticks
+struct SpawnRecord
+{
+  int64_t due;
+  MonsterRecord monster;
+};
+
+
+struct ChunkRecord
+{
+  int32_t x, y;
+};
+
+
+// The chunk's own snapshot is size bytes from offset in the chunk data
+struct SavedChunkRecord
+{
+  int32_t x, y;
+  uint8_t generated;
+  uint8_t padding[7];
+  uint64_t offset;
+  uint64_t size;
+};
+
+
+struct PlayerRecord
+{
+  float x, y;
+  float last_x, last_y;
+  float vx, vy;
+  float radius;
+  float direction_x, direction_y;
+  int32_t health;
+  int32_t health_max;
+};
+
+
+struct SnapshotHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t endian_check;
+  uint64_t file_size;
+
+  uint8_t running;
+  uint8_t debug_enabled;
+  uint8_t drop_mode;
+  uint8_t padding;
+  float wallclock;
+  float mouse_x, mouse_y;
+  uint32_t world_seed;
+
+  PlayerRecord player;
+
+  Section strings;
+  Section items;
+  Section monsters;
+  Section bindings;
+  Section projectiles; // Column per ProjectileStore array, count long each, hostile flags last
+  Section spawns;
+  Section loaded_chunks;
+  Section saved_chunks;
+  Section chunk_data;
+};
+
+
+static_assert(std::is_trivially_copyable<SnapshotHeader>::value, "Snapshot records must be plain data");
+static_assert(sizeof(ItemRecord) == 84, "ItemRecord layout changed, bump SNAPSHOT_VERSION");
+static_assert(sizeof(MonsterRecord) == 60, "MonsterRecord layout changed, bump SNAPSHOT_VERSION");
+static_assert(sizeof(SavedChunkRecord) == 32, "SavedChunkRecord layout changed, bump SNAPSHOT_VERSION");
+
+// The 4 byte columns, then a byte each for hostile
+constexpr int PROJECTILE_COLUMNS{9};
+constexpr int PROJECTILE_BYTES{4 * PROJECTILE_COLUMNS + 1};
+
+
+size_t AlignUp(size_t n)
+{
+  return (n + SNAPSHOT_ALIGN - 1) & ~(SNAPSHOT_ALIGN - 1);
+}
+
+
+///////////////////////////////////////
+
+
+class SnapshotWriter
+{
+private:
+  std::unordered_map<std::string, StringRef> interned;
+  std::string string_data;
+
+public:
+  std::vector<char> out;
+
+  StringRef Intern(const std::string &s)
+  {
+    auto it = interned.find(s);
+    if (it != interned.end()) return it->second;
+
+    StringRef ref{uint32_t(string_data.size()), uint32_t(s.size())};
+    string_data += s;
+    interned.insert({s, ref});
+    return ref;
+  }
+
+  // Appends count things, returns where they went
+  Section Append(const void *data, size_t bytes, uint64_t count)
+  {
+    out.resize(AlignUp(out.size()));
+    const size_t offset = out.size();
+    out.resize(offset + bytes);
+    if (bytes > 0) std::memcpy(out.data() + offset, data, bytes);
+    return {offset, count};
+  }
+
+  Section AppendStrings() { return Append(string_data.data(), string_data.size(), string_data.size()); }
+};
+
+
+ItemRecord ToRecord(const Item &item, SnapshotWriter &writer)
+{
+  ItemRecord r{};
+  r.type = int32_t(item.type);
+  r.command = int32_t(item.command);
+  r.x = item.position.x;
+  r.y = item.position.y;
+  r.vx = item.velocity.x;
+  r.vy = item.velocity.y;
+  r.radius = item.radius;
+  r.colour[0] = item.colour.r;
+  r.colour[1] = item.colour.g;
+  r.colour[2] = item.colour.b;
+  r.colour[3] = item.colour.a;
+  r.colliding = item.colliding;
+  r.has_cooldown = item.has_cooldown;
+  r.has_limited_uses = item.has_limited_uses;
+  r.awake = item.awake;
+  r.cooldown_ready = item.cooldown_ready;
+  r.cooldown_max = item.cooldown_max;
+  r.uses_left = item.uses_left;
+  r.uses_max = item.uses_max;
+  r.count = item.count;
+  r.healing_amount = item.healing_amount;
+  r.projectile_damage = item.projectile_damage;
+  r.animation_offset = item.animation_offset;
+  r.name = writer.Intern(item.name);
+  r.animation = writer.Intern(item.animation);
+  return r;
+}
+
+
+MonsterRecord ToRecord(const Monster &m, SnapshotWriter &writer)
+{
+  return {int32_t(m.type), m.position.x, m.position.y, m.last_position.x, m.last_position.y,
+          m.velocity.x, m.velocity.y, m.radius, m.health.current, m.health.max, m.fire_ready,
+          m.moved_at, m.step_dt, writer.Intern(m.name)};
+}
+
+
+///////////////////////////////////////
+
+
+class SnapshotReader
+{
+private:
+  const char *data;
+  size_t size;
+
+public:
+  const SnapshotHeader *header;
+
+  SnapshotReader(const char *data, size_t size)
+  : data(data)
+  , size(size)
+  {
+    if (size < sizeof(SnapshotHeader))
+    {
+      throw std::runtime_error("Snapshot is too small");
+    }
+
+    header = reinterpret_cast<const SnapshotHeader *>(data);
+
+    if (std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+      throw std::runtime_error("Not a snapshot");
+    }
+    if (header->endian_check != SNAPSHOT_ENDIAN_CHECK)
+    {
+      throw std::runtime_error("Snapshot was written on a machine with different endianness");
+    }
+    if (header->version != SNAPSHOT_VERSION)
+    {
+      throw std::runtime_error("Snapshot is version " + std::to_string(header->version) +
+                               ", expected " + std::to_string(SNAPSHOT_VERSION));
+    }
+    if (header->file_size != size)
+    {
+      throw std::runtime_error("Snapshot is truncated");
+    }
+
+    CheckSection(header->strings, 1);
+    CheckSection(header->items, sizeof(ItemRecord));
+    CheckSection(header->monsters, sizeof(MonsterRecord));
+    CheckSection(header->bindings, sizeof(BindingRecord));
+    CheckSection(header->projectiles, PROJECTILE_BYTES);
+    CheckSection(header->spawns, sizeof(SpawnRecord));
+    CheckSection(header->loaded_chunks, sizeof(ChunkRecord));
+    CheckSection(header->saved_chunks, sizeof(SavedChunkRecord));
+    CheckSection(header->chunk_data, 1);
+  }
+
+  void CheckSection(const Section &section, size_t record_size) const
+  {
+    if (section.offset % SNAPSHOT_ALIGN != 0 or section.offset > size or
+        section.count > (size - section.offset) / record_size)
+    {
+      throw std::runtime_error("Snapshot has a corrupt section");
+    }
+  }
+
+  template<typename T>
+  const T *Records(const Section &section) const
+  {
+    return reinterpret_cast<const T *>(data + section.offset);
+  }
+
+  std::string String(StringRef ref) const
+  {
+    if (ref.offset > header->strings.count or ref.length > header->strings.count - ref.offset)
+    {
+      throw std::runtime_error("Snapshot has a corrupt string");
+    }
+    return std::string(data + header->strings.offset + ref.offset, ref.length);
+  }
+
+  // Anything outside none to last is from a corrupt or foreign file
+  template<typename E>
+  static E Enum(int32_t value, E last)
+  {
+    if (value < 0 or value > int32_t(last))
+    {
+      throw std::runtime_error("Snapshot has a corrupt type");
+    }
+    return E(value);
+  }
+
+  Item FromRecord(const ItemRecord &r) const
+  {
+    Item item;
+    item.type = Enum(r.type, Item_Type::gun);
+    item.command = Enum(r.command, Command_Type::drop);
+    item.position = item.last_position = {r.x, r.y};
+    item.velocity = {r.vx, r.vy};
+    item.radius = r.radius;
+    item.colour.r = r.colour[0];
+    item.colour.g = r.colour[1];
+    item.colour.b = r.colour[2];
+    item.colour.a = r.colour[3];
+    item.colliding = r.colliding;
+    item.has_cooldown = r.has_cooldown;
+    item.has_limited_uses = r.has_limited_uses;
+    item.awake = r.awake;
+    item.cooldown_ready = r.cooldown_ready;
+    item.cooldown_max = r.cooldown_max;
+    item.uses_left = r.uses_left;
+    item.uses_max = r.uses_max;
+    item.count = r.count;
+    item.healing_amount = r.healing_amount;
+    item.projectile_damage = r.projectile_damage;
+    item.animation_offset = r.animation_offset;
+    item.name = String(r.name);
+    item.animation = String(r.animation);
+    return item;
+  }
+
+  Monster FromRecord(const MonsterRecord &r) const
+  {
+    Monster m;
+    m.type = Enum(r.type, Monster_Type::shooter);
+    m.position = {r.x, r.y};
+    m.last_position = {r.last_x, r.last_y};
+    m.velocity = {r.vx, r.vy};
+    m.radius = r.radius;
+    m.health = {r.health, r.health_max};
+    m.fire_ready = r.fire_ready;
+    m.moved_at = r.moved_at;
+    m.step_dt = r.step_dt;
+    m.name = String(r.name);
+    return m;
+  }
+};
+
+
+template<typename T>
+void ReadColumn(const char *column, size_t count, std::vector<T> &dest)
+{
+  dest.resize(count);
+  if (count > 0) std::memcpy(dest.data(), column, count * sizeof(T));
+}
+
+} // namespace
+
+
+///////////////////////////////////////
+
+
+std::vector<char> WriteSnapshot(const GameState &state)
+{
+  SnapshotWriter writer;
+  writer.out.reserve(sizeof(SnapshotHeader) + 9 * SNAPSHOT_ALIGN + state.world_items.size() * sizeof(ItemRecord) +
+                     state.world_monsters.size() * sizeof(MonsterRecord) +
+                     state.world_projectiles.size() * PROJECTILE_BYTES + 1024);
+
+  SnapshotHeader header{};
+  std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.version = SNAPSHOT_VERSION;
+  header.endian_check = SNAPSHOT_ENDIAN_CHECK;
+
+  header.running = state.running;
+  header.debug_enabled = state.debug_enabled;
+  header.drop_mode = state.drop_mode;
+  header.wallclock = state.wallclock;
+  header.mouse_x = state.mouse_position.x;
+  header.mouse_y = state.mouse_position.y;
+  header.world_seed = state.world_seed;
+
+  const Player &player = state.player;
+  header.player = {player.position.x, player.position.y, player.last_position.x, player.last_position.y,
+                   player.velocity.x, player.velocity.y, player.radius,
+                   player.direction.x, player.direction.y, player.health.current, player.health.max};
+
+  writer.Append(&header, sizeof(header), 1);
+
+  std::vector<ItemRecord> items;
+  items.reserve(state.world_items.size());
+  for (auto &item : state.world_items)
+  {
+    items.push_back(ToRecord(item, writer));
+  }
+  header.items = writer.Append(items.data(), items.size() * sizeof(ItemRecord), items.size());
+
+  // Dead monsters are on their way out anyway
+  std::vector<MonsterRecord> monsters;
+  monsters.reserve(state.world_monsters.size());
+  for (auto &m : state.world_monsters)
+  {
+    if (not m.alive) continue;
+    monsters.push_back(ToRecord(m, writer));
+  }
+  header.monsters = writer.Append(monsters.data(), monsters.size() * sizeof(MonsterRecord), monsters.size());
+
+  std::vector<BindingRecord> bindings;
+  for (auto &binding : player.KeyBindInventory)
+  {
+    bindings.push_back({binding.key, 0, ToRecord(binding.item, writer)});
+  }
+  header.bindings = writer.Append(bindings.data(), bindings.size() * sizeof(BindingRecord), bindings.size());
+
+  const ProjectileStore &p = state.world_projectiles;
+  const size_t n = p.size();
+  header.projectiles = writer.Append(p.x.data(), n * 4, n);
+  for (const std::vector<float> *column : {&p.y, &p.last_x, &p.last_y, &p.vx, &p.vy, &p.expire_time, &p.radius})
+  {
+    writer.out.insert(writer.out.end(), (const char *)column->data(), (const char *)(column->data() + n));
+  }
+  writer.out.insert(writer.out.end(), (const char *)p.damage.data(), (const char *)(p.damage.data() + n));
+  writer.out.insert(writer.out.end(), p.hostile.begin(), p.hostile.end());
+
+  std::vector<SpawnRecord> spawns;
+  state.monster_spawns.ForEach([&](int64_t due, const Monster &m) { spawns.push_back({due, ToRecord(m, writer)}); });
+  header.spawns = writer.Append(spawns.data(), spawns.size() * sizeof(SpawnRecord), spawns.size());
+
+  std::vector<ChunkRecord> loaded;
+  for (ChunkCoord coord : state.loaded_chunks)
+  {
+    loaded.push_back({coord.x, coord.y});
+  }
+  header.loaded_chunks = writer.Append(loaded.data(), loaded.size() * sizeof(ChunkRecord), loaded.size());
+
+  std::vector<SavedChunkRecord> saved;
+  std::vector<char> chunk_data;
+  for (const SavedChunk &chunk : state.saved_chunks)
+  {
+    SavedChunkRecord r{};
+    r.x = chunk.coord.x;
+    r.y = chunk.coord.y;
+    r.generated = chunk.generated;
+    r.offset = chunk_data.size();
+    r.size = chunk.snapshot.size();
+    saved.push_back(r);
+    chunk_data.insert(chunk_data.end(), chunk.snapshot.begin(), chunk.snapshot.end());
+  }
+  header.saved_chunks = writer.Append(saved.data(), saved.size() * sizeof(SavedChunkRecord), saved.size());
+  header.chunk_data = writer.Append(chunk_data.data(), chunk_data.size(), chunk_data.size());
+
+  header.strings = writer.AppendStrings();
+
+  header.file_size = AlignUp(writer.out.size());
+  writer.out.resize(header.file_size);
+  std::memcpy(writer.out.data(), &header, sizeof(header));
+
+  return std::move(writer.out);
+}
+
+
+void SaveSnapshot(const GameState &state, const std::string &filename)
+{
+  const std::vector<char> data = WriteSnapshot(state);
+
+  std::ofstream out(filename, std::ios::binary);
+  out.write(data.data(), data.size());
+  if (not out)
+  {
+    throw std::runtime_error("Could not write snapshot " + filename);
+  }
+}
+
+
+void ReadSnapshot(const char *data, size_t size, GameState &state)
+{
+  const SnapshotReader reader(data, size);
+  const SnapshotHeader &header = *reader.header;
+
+  state.running = header.running;
+  state.debug_enabled = header.debug_enabled;
+  state.drop_mode = header.drop_mode;
+  state.wallclock = header.wallclock;
+  state.mouse_position = {header.mouse_x, header.mouse_y};
+
+  const PlayerRecord &p = header.player;
+  Player &player = state.player;
+  player.position = {p.x, p.y};
+  player.last_position = {p.last_x, p.last_y};
+  player.velocity = {p.vx, p.vy};
+  player.radius = p.radius;
+  player.direction = {p.direction_x, p.direction_y};
+  player.health = {p.health, p.health_max};
+
+  player.KeyBindInventory.clear();
+  const BindingRecord *bindings = reader.Records<BindingRecord>(header.bindings);
+  for (uint64_t i = 0; i < header.bindings.count; i++)
+  {
+    player.KeyBindInventory.Bind(bindings[i].key, reader.FromRecord(bindings[i].item));
+  }
+
+  state.world_items.clear();
+  state.world_items.reserve(int(header.items.count));
+  const ItemRecord *items = reader.Records<ItemRecord>(header.items);
+  for (uint64_t i = 0; i < header.items.count; i++)
+  {
+    state.world_items.Insert(reader.FromRecord(items[i]));
+  }
+
+  state.awake_items.clear();
+  for (int i = 0; i < state.world_items.size(); i++)
+  {
+    if (state.world_items[i].awake) state.awake_items.push_back(state.world_items.HandleAt(i));
+  }
+
+  state.world_monsters.clear();
+  state.world_monsters.reserve(int(header.monsters.count));
+  const MonsterRecord *monsters = reader.Records<MonsterRecord>(header.monsters);
+  for (uint64_t i = 0; i < header.monsters.count; i++)
+  {
+    state.world_monsters.Insert(reader.FromRecord(monsters[i]));
+  }
+
+  ProjectileStore &projectiles = state.world_projectiles;
+  const size_t n = header.projectiles.count;
+  const char *column = data + header.projectiles.offset;
+  for (std::vector<float> *dest : {&projectiles.x, &projectiles.y, &projectiles.last_x, &projectiles.last_y,
+                                   &projectiles.vx, &projectiles.vy, &projectiles.expire_time, &projectiles.radius})
+  {
+    ReadColumn(column, n, *dest);
+    column += n * 4;
+  }
+  ReadColumn(column, n, projectiles.damage);
+  column += n * 4;
+  ReadColumn(column, n, projectiles.hostile);
+  projectiles.RebuildSlots(state.wallclock);
+
+  // In the same order, so they come out in the same order
+  state.monster_spawns.clear(TimerTick(state.wallclock));
+  const SpawnRecord *spawns = reader.Records<SpawnRecord>(header.spawns);
+  for (uint64_t i = 0; i < header.spawns.count; i++)
+  {
+    state.monster_spawns.Schedule(spawns[i].due, reader.FromRecord(spawns[i].monster));
+  }
+
+  state.world_seed = header.world_seed;
+
+  state.loaded_chunks.clear();
+  const ChunkRecord *loaded = reader.Records<ChunkRecord>(header.loaded_chunks);
+  for (uint64_t i = 0; i < header.loaded_chunks.count; i++)
+  {
+    state.loaded_chunks.push_back({loaded[i].x, loaded[i].y});
+  }
+
+  state.saved_chunks.clear();
+  const SavedChunkRecord *saved = reader.Records<SavedChunkRecord>(header.saved_chunks);
+  const char *chunk_data = data + header.chunk_data.offset;
+  for (uint64_t i = 0; i < header.saved_chunks.count; i++)
+  {
+    const SavedChunkRecord &r = saved[i];
+    if (r.offset > header.chunk_data.count or r.size > header.chunk_data.count - r.offset)
+    {
+      throw std::runtime_error("Snapshot has a corrupt saved chunk");
+    }
+    state.saved_chunks.push_back({{r.x, r.y}, bool(r.generated),
+                                  std::vector<char>(chunk_data + r.offset, chunk_data + r.offset + r.size)});
+  }
+
+  state.dead_monsters.clear();
+  state.closest_item = {};
+  state.mouseover_item = {};
+  state.mouseover_monster = {};
+}
+
+
+void LoadSnapshot(const std::string &filename, GameState &state)
+{
+  MappedFile file(filename);
+  ReadSnapshot(file.Data(), file.Size(), state);
+}
+
+
+std::vector<SnapshotSpan> SnapshotLayout(const char *data, size_t size)
+{
+  const SnapshotReader reader(data, size);
+  const SnapshotHeader &header = *reader.header;
+
+  std::vector<SnapshotSpan> spans;
+  spans.push_back({0, sizeof(SnapshotHeader)});
+  spans.push_back({header.items.offset, header.items.count * sizeof(ItemRecord)});
+  spans.push_back({header.monsters.offset, header.monsters.count * sizeof(MonsterRecord)});
+  spans.push_back({header.bindings.offset, header.bindings.count * sizeof(BindingRecord)});
+
+  const size_t column_size = header.projectiles.count * 4;
+  for (int c = 0; c < PROJECTILE_COLUMNS; c++)
+  {
+    spans.push_back({header.projectiles.offset + c * column_size, column_size});
+  }
+  spans.push_back({header.projectiles.offset + PROJECTILE_COLUMNS * column_size, header.projectiles.count});
+
+  spans.push_back({header.spawns.offset, header.spawns.count * sizeof(SpawnRecord)});
+  spans.push_back({header.loaded_chunks.offset, header.loaded_chunks.count * sizeof(ChunkRecord)});
+  spans.push_back({header.saved_chunks.offset, header.saved_chunks.count * sizeof(SavedChunkRecord)});
+  spans.push_back({header.chunk_data.offset, header.chunk_data.count});
+  spans.push_back({header.strings.offset, header.strings.count});
+  return spans;
+}
+
+
+///////////////////////////////////////
+
+
+MappedFile::MappedFile(const std::string &filename)
+{
+#ifndef _WIN32
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw std::runtime_error("Could not open " + filename);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 and info.st_size > 0)
+  {
+    void *map = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED)
+    {
+      data = static_cast<const char *>(map);
+      size = size_t(info.st_size);
+      mapped = true;
+    }
+  }
+  close(fd);
+
+  if (mapped) return;
+#endif
+
+  // No mmap, read the whole thing instead
+  std::ifstream in(filename, std::ios::binary);
+  if (not in)
+  {
+    throw std::runtime_error("Could not open " + filename);
+  }
+  buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  data = buffer.data();
+  size = buffer.size();
+}
+
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+  if (mapped) munmap(const_cast<char *>(data), size);
+#endif
+}
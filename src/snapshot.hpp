@@ -0,0 +1,54 @@
+#pragma once
+
+// Binary snapshot of a GameState, for quick restarts and benchmark setup.
+//
+// Everything is flat little endian arrays addressed by offsets from the start
+// of the file, with the strings interned into one table, so a snapshot can be
+// used straight out of a memory mapped file.  Restoring copies each array in
+// bulk, and only allocates per container, not per entity.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "game_types.hpp"
+
+
+std::vector<char> WriteSnapshot(const GameState &state);
+void SaveSnapshot(const GameState &state, const std::string &filename); //Throws
+
+// Replaces everything in state.  Throws if the data is not a valid snapshot.
+void ReadSnapshot(const char *data, size_t size, GameState &state);
+void LoadSnapshot(const std::string &filename, GameState &state); //Throws
+
+
+// Each array in a snapshot, always in the same order, so two snapshots can be
+// compared array by array even when the entity counts differ
+struct SnapshotSpan
+{
+  size_t offset;
+  size_t size;
+};
+
+std::vector<SnapshotSpan> SnapshotLayout(const char *data, size_t size); //Throws
+
+
+// Read only view of a whole file, memory mapped where the platform allows
+class MappedFile
+{
+private:
+  const char *data = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+  std::vector<char> buffer;
+
+public:
+  explicit MappedFile(const std::string &filename); //Throws
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *Data() const { return data; }
+  size_t Size() const { return size; }
+};
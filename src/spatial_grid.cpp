@@ -0,0 +1,104 @@
+#include "spatial_grid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Stops a few far apart entities from making a huge mostly empty grid
+constexpr int MAX_CELLS_PER_ENTITY{4};
+
+
+void SpatialGrid::Clear()
+{
+  circles.clear();
+  max_radius = 0.0f;
+}
+
+
+void SpatialGrid::Add(vec2 position, float radius)
+{
+  circles.Add(position, radius);
+  max_radius = std::max(max_radius, radius);
+}
+
+
+int SpatialGrid::CellX(float x) const
+{
+  int cx = int(std::floor((x - origin.x) / cell_size));
+  return std::min(std::max(cx, 0), columns - 1);
+}
+
+
+int SpatialGrid::CellY(float y) const
+{
+  int cy = int(std::floor((y - origin.y) / cell_size));
+  return std::min(std::max(cy, 0), rows - 1);
+}
+
+
+void SpatialGrid::Build()
+{
+  columns = rows = 0;
+  cell_start.clear();
+  cell_entries.clear();
+
+  const int count = circles.size();
+  if (count == 0) return;
+
+  vec2 min{circles.x[0], circles.y[0]};
+  vec2 max = min;
+  for (int i = 0; i < count; i++)
+  {
+    min.x = std::min(min.x, circles.x[i]);
+    min.y = std::min(min.y, circles.y[i]);
+    max.x = std::max(max.x, circles.x[i]);
+    max.y = std::max(max.y, circles.y[i]);
+  }
+
+  origin = min;
+  cell_size = std::max(max_radius * 2.0f, 1.0f);
+
+  const long max_cells = long(count) * MAX_CELLS_PER_ENTITY + 16;
+  while (true)
+  {
+    columns = int((max.x - min.x) / cell_size) + 1;
+    rows = int((max.y - min.y) / cell_size) + 1;
+
+    if (long(columns) * long(rows) <= max_cells) break;
+    cell_size *= 2.0f;
+  }
+
+  // Counting sort of entities into cells
+  const int num_cells = columns * rows;
+  cell_start.assign(num_cells + 1, 0);
+  entity_cell.resize(count);
+
+  for (int i = 0; i < count; i++)
+  {
+    int cell = CellY(circles.y[i]) * columns + CellX(circles.x[i]);
+    entity_cell[i] = cell;
+    cell_start[cell + 1]++;
+  }
+
+  for (int c = 0; c < num_cells; c++)
+  {
+    cell_start[c + 1] += cell_start[c];
+  }
+
+  cell_entries.resize(count);
+  sorted.x.resize(count);
+  sorted.y.resize(count);
+  sorted.radius.resize(count);
+
+  cell_fill.assign(cell_start.begin(), cell_start.end() - 1);
+  for (int i = 0; i < count; i++)
+  {
+    const int slot = cell_fill[entity_cell[i]]++;
+    cell_entries[slot] = i;
+    sorted.x[slot] = circles.x[i];
+    sorted.y[slot] = circles.y[i];
+    sorted.radius[slot] = circles.radius[i];
+  }
+
+  assert(cell_start[num_cells] == count);
+}
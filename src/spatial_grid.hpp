@@ -0,0 +1,144 @@
+#pragma once
+
+// Uniform grid broadphase over a set of circles.
+// Rebuilt from scratch every tick, which is cheap (two passes over the
+// entities), and avoids having to track anything moving between cells.
+
+#include <algorithm>
+#include <vector>
+
+#include "collision.hpp"
+#include "maths_types.hpp"
+
+
+class SpatialGrid
+{
+private:
+  static constexpr int MIN_BATCH = 16;
+
+  CircleList circles;
+
+  // Copy of the circles in cell order, so each row of cells is one batch
+  CircleList sorted;
+
+  float cell_size = 1.0f;
+  float max_radius = 0.0f;
+  vec2 origin{0.0f, 0.0f};
+  int columns = 0;
+  int rows = 0;
+
+  // Entity indexes sorted by cell, cell N is [cell_start[N], cell_start[N+1])
+  std::vector<int> cell_start;
+  std::vector<int> cell_entries;
+  std::vector<int> entity_cell;
+  std::vector<int> cell_fill;
+
+  int CellX(float x) const;
+  int CellY(float y) const;
+
+public:
+  void Clear();
+  void Add(vec2 position, float radius);
+
+  // Sorts everything added since Clear() into cells.  Cell size comes from
+  // the biggest radius, so a query never needs to look more than one cell out.
+  void Build();
+
+  int Size() const { return circles.size(); }
+
+  // As they were added, so stays put while the entities themselves move
+  vec2 Position(int index) const { return {circles.x[index], circles.y[index]}; }
+  float Radius(int index) const { return circles.radius[index]; }
+  float CellSize() const { return cell_size; }
+
+  // Calls func(index) for every circle that might touch the query circle.
+  // Candidates still need an exact test.
+  template<typename FUNC>
+  void Query(vec2 position, float radius, FUNC &&func) const
+  {
+    if (circles.size() == 0) return;
+
+    const float reach = radius + max_radius;
+
+    const int x1 = CellX(position.x - reach);
+    const int x2 = CellX(position.x + reach);
+    const int y1 = CellY(position.y - reach);
+    const int y2 = CellY(position.y + reach);
+
+    for (int y = y1; y <= y2; y++)
+    {
+      for (int x = x1; x <= x2; x++)
+      {
+        const int cell = y * columns + x;
+        for (int i = cell_start[cell]; i < cell_start[cell + 1]; i++)
+        {
+          func(cell_entries[i]);
+        }
+      }
+    }
+  }
+
+  // Calls func(index) for every circle that overlaps the query circle,
+  // testing a whole row of cells at a time with OverlapBatch.
+  template<typename FUNC>
+  void QueryOverlaps(vec2 position, float radius, FUNC &&func) const
+  {
+    QueryOverlapSlots(position, radius, [&](int slot) { func(cell_entries[slot]); });
+  }
+
+  // Same, but as func(index, position, radius), read from the cell ordered
+  // copy so neighbours next to each other in space are next to each other in memory.
+  template<typename FUNC>
+  void QueryNeighbours(vec2 position, float radius, FUNC &&func) const
+  {
+    QueryOverlapSlots(position, radius, [&](int slot) {
+      func(cell_entries[slot], vec2{sorted.x[slot], sorted.y[slot]}, sorted.radius[slot]);
+    });
+  }
+
+private:
+  // Calls func(slot) with the slot in the sorted arrays
+  template<typename FUNC>
+  void QueryOverlapSlots(vec2 position, float radius, FUNC &&func) const
+  {
+    if (circles.size() == 0) return;
+
+    const float reach = radius + max_radius;
+
+    const int x1 = CellX(position.x - reach);
+    const int x2 = CellX(position.x + reach);
+    const int y1 = CellY(position.y - reach);
+    const int y2 = CellY(position.y + reach);
+
+    for (int y = y1; y <= y2; y++)
+    {
+      const int begin = cell_start[y * columns + x1];
+      const int end = cell_start[y * columns + x2 + 1];
+
+      // Not worth the call for a few circles
+      if (end - begin < MIN_BATCH)
+      {
+        for (int i = begin; i < end; i++)
+        {
+          const float dx = sorted.x[i] - position.x;
+          const float dy = sorted.y[i] - position.y;
+          const float radii = sorted.radius[i] + radius;
+          if (dx * dx + dy * dy <= radii * radii) func(i);
+        }
+        continue;
+      }
+
+      for (int chunk = begin; chunk < end; chunk += 64)
+      {
+        const int count = std::min(64, end - chunk);
+
+        uint64_t hits;
+        OverlapBatch(position, radius,
+          sorted.x.data() + chunk, sorted.y.data() + chunk, sorted.radius.data() + chunk,
+          count, &hits);
+
+        ForEachHit(&hits, count, [&](int i) { func(chunk + i); });
+      }
+    }
+  }
+};
@@ -0,0 +1,115 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+
+ThreadPool::ThreadPool(int num_threads)
+{
+  if (num_threads <= 0)
+  {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int i = 1; i < num_threads; i++)
+  {
+    workers.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  work_ready.notify_all();
+
+  for (auto &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+
+void ThreadPool::RunChunks()
+{
+  while (true)
+  {
+    const int chunk = next_chunk.fetch_add(1);
+    if (chunk >= job_chunks) break;
+
+    const int begin = chunk * job_chunk_size;
+    const int end = std::min(begin + job_chunk_size, job_count);
+    (*job)(chunk, begin, end);
+  }
+}
+
+
+void ThreadPool::WorkerLoop()
+{
+  long last_job = 0;
+
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      work_ready.wait(lock, [&] { return quitting or job_id != last_job; });
+      if (quitting) return;
+
+      last_job = job_id;
+      busy_workers++;
+    }
+
+    RunChunks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      busy_workers--;
+    }
+    work_done.notify_one();
+  }
+}
+
+
+void ThreadPool::ParallelFor(int count, int chunk_size, const ChunkFunc &func)
+{
+  assert(chunk_size > 0);
+  if (count <= 0) return;
+
+  const int chunks = NumChunks(count, chunk_size);
+
+  if (chunks == 1 or workers.empty())
+  {
+    for (int chunk = 0; chunk < chunks; chunk++)
+    {
+      const int begin = chunk * chunk_size;
+      func(chunk, begin, std::min(begin + chunk_size, count));
+    }
+    return;
+  }
+
+  {
+    // A worker that woke up too late for the last job may still be on its
+    // way out of it, wait for that before changing the job details.
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [&] { return busy_workers == 0; });
+
+    job = &func;
+    job_count = count;
+    job_chunk_size = chunk_size;
+    job_chunks = chunks;
+    next_chunk = 0;
+    job_id++;
+  }
+  work_ready.notify_all();
+
+  RunChunks();
+
+  // Workers that wake up late for this job find next_chunk already past
+  // the end, so they never touch func after we return.
+  std::unique_lock<std::mutex> lock(mutex);
+  work_done.wait(lock, [&] { return busy_workers == 0; });
+  job = nullptr;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// Minimal fork/join thread pool for splitting the simulation passes up.
+// Work is handed out in fixed size chunks, and the chunk boundaries only
+// depend on the amount of work, never on the number of threads.  So as long
+// as each chunk writes its own results, the output is the same however many
+// threads there are.
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+  using ChunkFunc = std::function<void(int chunk, int begin, int end)>;
+
+  // 0 threads means one per hardware thread.  The calling thread counts as one.
+  explicit ThreadPool(int num_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &copy) = delete;
+  ThreadPool &operator=(const ThreadPool &copy) = delete;
+
+  int NumThreads() const { return int(workers.size()) + 1; }
+
+  static int NumChunks(int count, int chunk_size) { return (count + chunk_size - 1) / chunk_size; }
+
+  // Calls func for each chunk of [0, count), and waits for them all to finish.
+  // Small jobs (one chunk) just run on the calling thread.
+  void ParallelFor(int count, int chunk_size, const ChunkFunc &func);
+
+private:
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+
+  bool quitting = false;
+  long job_id = 0;
+  int busy_workers = 0;
+
+  const ChunkFunc *job = nullptr;
+  int job_count = 0;
+  int job_chunk_size = 0;
+  int job_chunks = 0;
+  std::atomic<int> next_chunk{0};
+
+  void WorkerLoop();
+  void RunChunks();
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+// Hierarchical timer wheel.
+// Schedule() and firing are O(1) (amortised, a timer is moved down a level
+// at most LEVELS - 1 times on its way), and nothing is done per tick for
+// timers that are not due, so a thing with a timer on it costs nothing until
+// the timer goes off.
+//
+// Time is in whole wheel ticks, TimerTick() converts from game seconds.
+// Timers that go off on the same tick fire in the order they were scheduled.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// Wheel ticks per second of game time
+constexpr float TIMER_RESOLUTION{240.0f};
+
+inline int64_t TimerTick(float seconds)
+{
+  return int64_t(std::floor(seconds * TIMER_RESOLUTION));
+}
+
+
+template<typename T>
+class TimerWheel
+{
+private:
+  static constexpr int BITS = 8;
+  static constexpr int SLOTS = 1 << BITS;
+  static constexpr int LEVELS = 4;
+  static constexpr int64_t MAX_DELAY = (int64_t(1) << (BITS * LEVELS)) - 1;
+
+  struct Node
+  {
+    int64_t due;
+    uint64_t sequence;
+    T value;
+    int next;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<int> free_nodes;
+
+  // Linked list per slot, appended at the tail
+  std::vector<int> slot_head;
+  std::vector<int> slot_tail;
+
+  // Scheduled for a time already gone, fire on the next Advance()
+  std::vector<int> overdue;
+
+  std::vector<int> firing;
+
+  int64_t now = 0;
+  uint64_t next_sequence = 0;
+  int count = 0;
+
+  static int Digit(int64_t time, int level) { return int((time >> (BITS * level)) & (SLOTS - 1)); }
+
+  void Push(int slot, int node)
+  {
+    nodes[node].next = -1;
+    if (slot_tail[slot] >= 0) nodes[slot_tail[slot]].next = node;
+    else slot_head[slot] = node;
+    slot_tail[slot] = node;
+  }
+
+  // Lowest level where the due time is in the current rotation
+  void Place(int node)
+  {
+    const int64_t due = nodes[node].due;
+    if (due <= now)
+    {
+      overdue.push_back(node);
+      return;
+    }
+
+    int level = 0;
+    while (level < LEVELS - 1 and (due >> (BITS * (level + 1))) != (now >> (BITS * (level + 1))))
+    {
+      level++;
+    }
+    Push(level * SLOTS + Digit(due, level), node);
+  }
+
+  int TakeSlot(int slot)
+  {
+    const int head = slot_head[slot];
+    slot_head[slot] = slot_tail[slot] = -1;
+    return head;
+  }
+
+  void Cascade(int level)
+  {
+    for (int node = TakeSlot(level * SLOTS + Digit(now, level)); node >= 0;)
+    {
+      const int next = nodes[node].next;
+      Place(node);
+      node = next;
+    }
+  }
+
+public:
+  TimerWheel()
+  : slot_head(SLOTS * LEVELS, -1)
+  , slot_tail(SLOTS * LEVELS, -1)
+  {
+  }
+
+  int64_t Now() const { return now; }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  void reserve(int capacity)
+  {
+    nodes.reserve(capacity);
+    free_nodes.reserve(capacity);
+    overdue.reserve(capacity);
+    firing.reserve(capacity);
+  }
+
+  // Also sets the time, for starting over
+  void clear(int64_t time = 0)
+  {
+    nodes.clear();
+    free_nodes.clear();
+    overdue.clear();
+    std::fill(slot_head.begin(), slot_head.end(), -1);
+    std::fill(slot_tail.begin(), slot_tail.end(), -1);
+    now = time;
+    count = 0;
+  }
+
+  // Anything due at or before Now() fires on the next Advance()
+  void Schedule(int64_t due, T value)
+  {
+    assert(due - now <= MAX_DELAY);
+    due = std::min(due, now + MAX_DELAY);
+
+    int node;
+    if (free_nodes.empty())
+    {
+      node = int(nodes.size());
+      nodes.push_back({due, next_sequence++, std::move(value), -1});
+    }
+    else
+    {
+      node = free_nodes.back();
+      free_nodes.pop_back();
+      nodes[node] = {due, next_sequence++, std::move(value), -1};
+    }
+
+    count++;
+    Place(node);
+  }
+
+  // Moves the time on, calling func(value) for every timer that is due.
+  // func can schedule more timers.
+  template<typename FUNC>
+  void Advance(int64_t time, FUNC &&func)
+  {
+    auto fire = [&]() {
+      std::sort(firing.begin(), firing.end(), [&](int a, int b) {
+        return nodes[a].sequence < nodes[b].sequence;
+      });
+      for (int node : firing)
+      {
+        T value = std::move(nodes[node].value);
+        free_nodes.push_back(node);
+        count--;
+        func(value);
+      }
+      firing.clear();
+    };
+
+    firing.swap(overdue);
+    fire();
+
+    while (now < time)
+    {
+      now++;
+
+      // From the top, so timers can drop more than one level at once
+      for (int level = LEVELS - 1; level > 0; level--)
+      {
+        if ((now & ((int64_t(1) << (BITS * level)) - 1)) == 0) Cascade(level);
+      }
+
+      // Cascading puts anything due right now in overdue
+      firing.swap(overdue);
+
+      for (int node = TakeSlot(Digit(now, 0)); node >= 0; node = nodes[node].next)
+      {
+        firing.push_back(node);
+      }
+      fire();
+    }
+  }
+
+  // Calls func(due, value) for every timer, in the order they will fire
+  template<typename FUNC>
+  void ForEach(FUNC &&func) const
+  {
+    std::vector<int> all;
+    all.insert(all.end(), overdue.begin(), overdue.end());
+    for (int slot = 0; slot < SLOTS * LEVELS; slot++)
+    {
+      for (int node = slot_head[slot]; node >= 0; node = nodes[node].next)
+      {
+        all.push_back(node);
+      }
+    }
+
+    std::sort(all.begin(), all.end(), [&](int a, int b) {
+      if (nodes[a].due != nodes[b].due) return nodes[a].due < nodes[b].due;
+      return nodes[a].sequence < nodes[b].sequence;
+    });
+
+    for (int node : all)
+    {
+      func(nodes[node].due, nodes[node].value);
+    }
+  }
+};
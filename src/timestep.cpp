@@ -0,0 +1,43 @@
+#include "timestep.hpp"
+
+#include <cassert>
+
+
+FixedTimestep::FixedTimestep(int ticks_per_second, int max_ticks_per_frame)
+: tick_length(1.0 / ticks_per_second)
+, max_ticks_per_frame(max_ticks_per_frame)
+{
+  assert(ticks_per_second > 0);
+  assert(max_ticks_per_frame > 0);
+}
+
+
+int FixedTimestep::Advance(double frame_seconds)
+{
+  if (frame_seconds > 0.0) accumulator += frame_seconds;
+
+  int ticks = int(accumulator / tick_length);
+
+  if (ticks > max_ticks_per_frame)
+  {
+    dropped_ticks += ticks - max_ticks_per_frame;
+    ticks = max_ticks_per_frame;
+    accumulator = 0.0;
+  }
+  else
+  {
+    accumulator -= ticks * tick_length;
+  }
+
+  total_ticks += ticks;
+
+  return ticks;
+}
+
+
+float FixedTimestep::Alpha() const
+{
+  float alpha = float(accumulator / tick_length);
+  if (alpha > 1.0f) alpha = 1.0f;
+  return alpha;
+}
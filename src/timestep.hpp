@@ -0,0 +1,33 @@
+#pragma once
+
+// Fixed rate simulation clock.  Real frame time is fed in, and whole ticks
+// are handed out, with the leftover used to interpolate rendering.
+
+
+class FixedTimestep
+{
+private:
+  double tick_length = 0.0;
+  int max_ticks_per_frame = 0;
+
+  double accumulator = 0.0;
+
+  long total_ticks = 0;
+  long dropped_ticks = 0;
+
+public:
+  FixedTimestep(int ticks_per_second, int max_ticks_per_frame);
+
+  float TickLength() const { return float(tick_length); }
+
+  // Adds real elapsed time, and returns how many ticks to simulate this frame.
+  // If the simulation falls too far behind, the extra time is thrown away
+  // rather than trying to catch up (and falling further behind).
+  int Advance(double frame_seconds);
+
+  // How far between the last tick and the next one we are, [0, 1)
+  float Alpha() const;
+
+  long TotalTicks() const { return total_ticks; }
+  long DroppedTicks() const { return dropped_ticks; }
+};
@@ -5,7 +5,7 @@
 
 #include <SDL.h>
 
-#include "gl.hpp"
+#include "keybinds.hpp"
 #include "maths_types.hpp"
 
 
@@ -51,56 +51,6 @@ std::ostream &operator<<(std::ostream &out, mat4 const &mat)
 }
 
 
-std::string GLenum_ToString(GLenum e)
-{
-  switch (e)
-  {
-
-    case GL_DEBUG_SEVERITY_HIGH:
-      return "SEVERITY_HIGH";
-    case GL_DEBUG_SEVERITY_MEDIUM:
-      return "SEVERITY_MEDIUM";
-    case GL_DEBUG_SEVERITY_LOW:
-      return "SEVERITY_LOW";
-    case GL_DEBUG_SEVERITY_NOTIFICATION:
-      return "NOTIFICATION";
-    case GL_DEBUG_TYPE_ERROR:
-      return "ERROR";
-    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-      return "DEPRECATED_BEHAVIOR";
-    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-      return "UNDEFINED_BEHAVIOR";
-    case GL_DEBUG_TYPE_PORTABILITY:
-      return "PORTABILITY";
-    case GL_DEBUG_TYPE_PERFORMANCE:
-      return "PERFORMANCE";
-    case GL_DEBUG_TYPE_MARKER:
-      return "MARKER";
-    case GL_DEBUG_TYPE_PUSH_GROUP:
-      return "PUSH_GROUP";
-    case GL_DEBUG_TYPE_POP_GROUP:
-      return "POP_GROUP";
-    case GL_DEBUG_TYPE_OTHER:
-      return "OTHER";
-    case GL_DEBUG_SOURCE_API:
-      return "SOURCE_API";
-    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
-      return "SOURCE_WINDOW_SYSTEM";
-    case GL_DEBUG_SOURCE_SHADER_COMPILER:
-      return "SHADER_COMPILER";
-    case GL_DEBUG_SOURCE_THIRD_PARTY:
-      return "SOURCE_THIRD_PARTY";
-    case GL_DEBUG_SOURCE_APPLICATION:
-      return "SOURCE_APPLICATION";
-    case GL_DEBUG_SOURCE_OTHER:
-      return "SOURCE_OTHER";
-
-    default:
-      return "[ERROR: Unknown GLenum]";
-  }
-}
-
-
 std::string CPPVersion()
 {
   if (__cplusplus > 201703L)
@@ -116,11 +66,11 @@ std::string CPPVersion()
 }
 
 
-std::string GetInputName(int button_or_key)
+std::string GetInputName(int input)
 {
-  if (button_or_key <= SDL_BUTTON_X2)
+  if (IsMouseInput(input))
   {
-    switch (button_or_key)
+    switch (input - MOUSE_INPUT_BASE)
     {
       case SDL_BUTTON_LEFT:
         return "Left Mouse";
@@ -138,7 +88,11 @@ std::string GetInputName(int button_or_key)
   }
   else
   {
-    std::string keyname = SDL_GetKeyName(button_or_key);
+    // Name of the key in the current keyboard layout if there is one,
+    // otherwise (eg, no video initialised) the name of the physical key
+    auto scancode = static_cast<SDL_Scancode>(input);
+    std::string keyname = SDL_GetKeyName(SDL_GetKeyFromScancode(scancode));
+    if (keyname.empty()) keyname = SDL_GetScancodeName(scancode);
     if (keyname.empty()) return "Unknown key or button";
     return keyname;
   }
@@ -9,7 +9,7 @@ void SetStreamFormat(std::ostream &os);
 
 
 //Game stuff
-std::string GetInputName(int button_or_key);
+std::string GetInputName(int input);
 
 
 //Maths stuff
@@ -19,10 +19,5 @@ std::ostream &operator<<(std::ostream &out, struct col4 const &v4);
 std::ostream &operator<<(std::ostream &out, struct mat4 const &mat);
 
 
-//GL stuff
-typedef uint32_t GLenum;
-std::string GLenum_ToString(GLenum e);
-
-
 //CPP stuff
 std::string CPPVersion();
@@ -4,11 +4,25 @@
 #include <ctime>
 
 Random::Random()
-: mt_rand(time(0))
+: Random(uint32_t(time(0)))
 {
 }
 
 
+Random::Random(uint32_t seed)
+: seed(seed)
+, mt_rand(seed)
+{
+}
+
+
+void Random::Seed(uint32_t new_seed)
+{
+  seed = new_seed;
+  mt_rand.seed(new_seed);
+}
+
+
 int Random::Int(int min, int max)
 {
   std::uniform_int_distribution<int> distribution(min, max);
@@ -4,7 +4,11 @@
 // Some standard container helpers, and other misc stuff
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <random>
+#include <vector>
 
 #include "maths_types.hpp"
 
@@ -35,13 +39,178 @@ bool key_exists(CONT &container, const KEY &key)
 ////////////////////////
 
 
+// Generational handle to something in a SlotMap.  Once the thing is removed
+// the handle goes stale, instead of pointing at whatever took its place.
+// A default constructed handle is null.
+struct SlotHandle
+{
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  explicit operator bool() const { return generation != 0; }
+
+  bool operator==(const SlotHandle &other) const
+  {
+    return index == other.index and generation == other.generation;
+  }
+  bool operator!=(const SlotHandle &other) const { return not(*this == other); }
+};
+
+
+// Densely packed container with stable handles.
+// Insert and Remove are O(1) (removal swaps the last element into the gap),
+// and iterating goes straight over the packed array, in no particular order.
+// Pointers and references are invalidated by Insert/Remove, handles are not.
+template<typename T>
+class SlotMap
+{
+private:
+  struct Slot
+  {
+    uint32_t dense_index = 0;
+    uint32_t generation = 1;
+  };
+
+  std::vector<T> dense;
+  std::vector<uint32_t> dense_slot;
+  std::vector<Slot> slots;
+  std::vector<uint32_t> free_slots;
+
+  uint64_t version = 0;
+
+  // Shared by every SlotMap<T>, so no two different sets of things ever have the same version
+  static inline std::atomic<uint64_t> versions{0};
+
+public:
+  SlotHandle Insert(T value)
+  {
+    version = ++versions;
+
+    uint32_t slot_index;
+    if (free_slots.empty())
+    {
+      slot_index = uint32_t(slots.size());
+      slots.emplace_back();
+    }
+    else
+    {
+      slot_index = free_slots.back();
+      free_slots.pop_back();
+    }
+
+    Slot &slot = slots[slot_index];
+    slot.dense_index = uint32_t(dense.size());
+
+    dense.push_back(std::move(value));
+    dense_slot.push_back(slot_index);
+
+    return {slot_index, slot.generation};
+  }
+
+  bool Contains(SlotHandle handle) const
+  {
+    return handle.index < slots.size() and slots[handle.index].generation == handle.generation;
+  }
+
+  // Returns false if the handle was already stale
+  bool Remove(SlotHandle handle)
+  {
+    if (not Contains(handle)) return false;
+    version = ++versions;
+
+    Slot &slot = slots[handle.index];
+    const uint32_t gap = slot.dense_index;
+    const uint32_t last = uint32_t(dense.size() - 1);
+
+    if (gap != last)
+    {
+      dense[gap] = std::move(dense[last]);
+      dense_slot[gap] = dense_slot[last];
+      slots[dense_slot[gap]].dense_index = gap;
+    }
+
+    dense.pop_back();
+    dense_slot.pop_back();
+
+    slot.generation++;
+    if (slot.generation == 0) slot.generation = 1;
+    free_slots.push_back(handle.index);
+
+    return true;
+  }
+
+  T *Get(SlotHandle handle)
+  {
+    return Contains(handle) ? &dense[slots[handle.index].dense_index] : nullptr;
+  }
+
+  const T *Get(SlotHandle handle) const
+  {
+    return Contains(handle) ? &dense[slots[handle.index].dense_index] : nullptr;
+  }
+
+  // Packed array index of the thing, -1 if it's gone
+  int IndexOf(SlotHandle handle) const
+  {
+    return Contains(handle) ? int(slots[handle.index].dense_index) : -1;
+  }
+
+  // Handle for the thing currently at a packed array index, null for -1
+  SlotHandle HandleAt(int dense_index) const
+  {
+    if (dense_index < 0) return {};
+    assert(dense_index < size());
+    const uint32_t slot_index = dense_slot[dense_index];
+    return {slot_index, slots[slot_index].generation};
+  }
+
+  void clear()
+  {
+    while (not dense.empty()) Remove(HandleAt(size() - 1));
+  }
+
+  void reserve(int capacity)
+  {
+    dense.reserve(capacity);
+    dense_slot.reserve(capacity);
+    slots.reserve(capacity);
+  }
+
+  int size() const { return int(dense.size()); }
+  bool empty() const { return dense.empty(); }
+
+  // Changes whenever something is inserted or removed, and is copied along
+  // with the contents.  Changing things in place doesn't count.
+  uint64_t Version() const { return version; }
+
+  // For when something changed in place in a way that matters to whoever checks Version()
+  void Touch() { version = ++versions; }
+
+  T &operator[](int dense_index) { return dense[dense_index]; }
+  const T &operator[](int dense_index) const { return dense[dense_index]; }
+
+  auto begin() { return dense.begin(); }
+  auto end() { return dense.end(); }
+  auto begin() const { return dense.begin(); }
+  auto end() const { return dense.end(); }
+};
+
+
+////////////////////////
+
+
 class Random
 {
 private:
+  uint32_t seed;
   std::mt19937 mt_rand;
 
 public:
   Random();
+  explicit Random(uint32_t seed);
+
+  void Seed(uint32_t new_seed);
+  uint32_t GetSeed() const { return seed; }
 
   int Int(int min, int max);
   float Float(float min, float max);